@@ -29,6 +29,8 @@
 #define NDIM  2
 
 #include "in_mddefs.h"
+#include "in_thread.h"
+#include "in_pairforce.h"
 #include "in_debug.h"
 
 typedef struct {
@@ -49,10 +51,14 @@ NameList nameList[] = {
   NameR (deltaT),
   NameR (density),
   NameI (initUcell),
+  NameI (nThread),
   NameI (stepAvg),
   NameI (stepEquil),
   NameI (stepLimit),
   NameR (temperature),
+  NameI (threadSpin),
+  NameI (threadStats),
+  NameI (threadSteal),
 };
 
 
@@ -123,39 +129,48 @@ void SetParams ()
   VSCopy (region, 1. / sqrt (density), initUcell);
   nMol = VProd (initUcell);
   velMag = sqrt (NDIM * (1. - 1. / nMol) * temperature);
+  nThread = Min (nThread, PAIR_THREAD_MAX);
+  SetPairParams (rCut, 1.);
 }
 
 void AllocArrays ()
 {
   AllocMem (mol, nMol, Mol);
+  InitThreads ();
+  AllocMemS (rS, nMol);
+  AllocMemS (raS, nMol);
+  SetPairBlocks (nMol);
 }
 
 void ComputeForces ()
 {
-  VecR dr;
-  real fcVal, rr, rrCut, rri, rri3;
-  int j1, j2, n;
-
-  rrCut = Sqr (rCut);
-  DO_MOL VZero (mol[n].ra);
-  uSum = 0.;
-  virSum = 0.;
-  for (j1 = 0; j1 < nMol - 1; j1 ++) {
-    for (j2 = j1 + 1; j2 < nMol; j2 ++) {
-      VSub (dr, mol[j1].r, mol[j2].r);
-      VWrapAll (dr);
-      rr = VLenSq (dr);
-      if (rr < rrCut) {
-        rri = 1. / rr;
-        rri3 = Cube (rri);
-        fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
-        VVSAdd (mol[j1].ra, fcVal, dr);
-        VVSAdd (mol[j2].ra, - fcVal, dr);
-        uSum += 4. * rri3 * (rri3 - 1.) + 1.;
-        virSum += fcVal * rr;
-      }
+  int r, t;
+
+  GatherPairCoords (NULL);
+  for (r = 0; r < nPairBlock; r ++) {
+    if (nThread > 1) {
+      SetThreadTasks ((nPairBlock + 1) / 2, 1, NULL, NULL);
+      THREAD_PROC_LOOP (ComputeForcesT, r);
+    } else {
+      for (t = 0; t < (nPairBlock + 1) / 2; t ++) PairTileRound (0, r, t);
     }
   }
+  ScatterPairAccels (NULL);
+  uSum = pairUSum;
+  virSum = pairVirSum;
+}
+
+/* the tiles of each round (see SetPairBlocks) share no particles, so
+   they are distributed among the threads as tasks */
+
+void *ComputeForcesT (void *tr)
+{
+  long ip;
+  int j, t;
+
+  QUERY_THREAD ();
+  THREAD_TASK_LOOP (t, j) PairTileRound (ip, QUERY_STAGE, t);
+  return (NULL);
 }
 
 
@@ -271,4 +286,6 @@ void PrintSummary (FILE *fp)
 #include "in_rand.c"
 #include "in_errexit.c"
 #include "in_namelist.c"
+#include "in_thread.c"
+#include "in_pairforce.c"
 #include "in_debug.c"
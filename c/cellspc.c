@@ -27,9 +27,14 @@
 
 
 #include "in_mddefs.h"
+#include "in_cellbin.h"
+#include "in_thread.h"
+#include "in_reorder.h"
+#include "in_pairforce.h"
+#include "in_gearpc.h"
 
 typedef struct {
-  VecR r, rv, ra, ra1, ra2, ro, rvo;
+  VecR r, rv, ra;
 } Mol;
 
 Mol *mol;
@@ -39,21 +44,34 @@ real deltaT, density, rCut, temperature, timeNow, uSum, velMag, vvSum;
 Prop kinEnergy, totEnergy;
 int moreCycles, nMol, stepAvg, stepCount, stepEquil, stepLimit;
 VecI cells;
-int *cellList;
+int **cellBuf, cellBinNow, cellIncr;
 real virSum;
 Prop pressure;
 real kinEnInitSum;
 int stepInitlzTemp;
+char pairLaw[NAME_S_LEN];
+int pairFloat, pairTabSize;
 
 NameList nameList[] = {
+  NameI (cellDiv),
+  NameI (cellIncr),
   NameR (deltaT),
   NameR (density),
   NameI (initUcell),
+  NameI (nThread),
+  NameI (pairFloat),
+  NameS (pairLaw),
+  NameI (pairTabSize),
+  NameI (reorderCurve),
   NameI (stepAvg),
   NameI (stepEquil),
   NameI (stepInitlzTemp),
   NameI (stepLimit),
+  NameI (stepReorder),
   NameR (temperature),
+  NameI (threadSpin),
+  NameI (threadStats),
+  NameI (threadSteal),
 };
 
 
@@ -68,6 +86,7 @@ int main (int argc, char **argv)
     SingleStep ();
     if (stepCount >= stepLimit) moreCycles = 0;
   }
+  if (threadStats) PrintThreadStats (stdout);
 }
 
 
@@ -76,10 +95,13 @@ void SingleStep ()
   ++ stepCount;
   timeNow = stepCount * deltaT;
   PredictorStep ();
-  ApplyBoundaryCond ();
+  if (stepReorder > 0 && stepCount % stepReorder == 0) {
+    ReorderMols ();
+    PermuteGearPC (reordPerm, nMol);
+    cellBinNow = 1;
+  }
   ComputeForces ();
   CorrectorStep ();
-  ApplyBoundaryCond ();
   EvalProps ();
   if (stepCount < stepEquil) AdjustInitTemp ();
   AccumProps (1);
@@ -93,153 +115,129 @@ void SingleStep ()
 void SetupJob ()
 {
   AllocArrays ();
+  PrintPairTab (stdout);
   stepCount = 0;
   InitCoords ();
   InitVels ();
   InitAccels ();
   AccumProps (0);
   kinEnInitSum = 0.;
+  cellBinNow = 1;
 }
 
 void SetParams ()
 {
-  rCut = pow (2., 1./6.);
+  rCut = SetPairLaw (pairLaw);
   VSCopy (region, 1. / pow (density, 1./3.), initUcell);
   nMol = VProd (initUcell);
   velMag = sqrt (NDIM * (1. - 1. / nMol) * temperature);
-  VSCopy (cells, 1. / rCut, region);
+  cellDiv = Max (cellDiv, 1);
+  VSCopy (cells, cellDiv / rCut, region);
+  nThread = Min (nThread, PAIR_THREAD_MAX);
 }
 
 void AllocArrays ()
 {
+  int k;
+
   AllocMem (mol, nMol, Mol);
-  AllocMem (cellList, VProd (cells) + nMol, int);
+  AllocGearPC (nMol);
+  AllocReorder ();
+  AllocCellBins (VProd (cells), nMol);
+  if (cellIncr) AllocCellMoves (VProd (cells), nMol);
+  InitThreads ();
+  AllocMem2 (cellBuf, nThread, nMol, int);
+  SetCellStencil (rCut);
+  if (nThread > 1) SetCellColors ();
+  AllocMemS (rS, nMol);
+  AllocMemS (raS, nMol);
+  BuildPairTab (pairTabSize);
+  if (pairTabLen > 0) pairFloat = 0;
+  if (pairFloat) AllocPairFloat (nMol, nThread);
 }
 
 
 void ComputeForces ()
 {
-  VecR dr, invWid, rs, shift;
-  VecI cc, m1v, m2v, vOff[] = OFFSET_VALS;
-  real fcVal, rr, rrCut, rri, rri3, uVal;
-  int c, j1, j2, m1, m1x, m1y, m1z, m2, n, offset;
-
-  rrCut = Sqr (rCut);
-  VDiv (invWid, cells, region);
-  for (n = nMol; n < nMol + VProd (cells); n ++) cellList[n] = -1;
-  DO_MOL {
-    VSAdd (rs, mol[n].r, 0.5, region);
-    VMul (cc, rs, invWid);
-    c = VLinear (cc, cells) + nMol;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
+  int c, m1;
+
+  if (cellBinNow) BIN_CELLS (mol, nMol);
+  else if (cellIncr) UpdateCellBins (nMol, VProd (cells));
+  else SortCellBins (nMol, VProd (cells));
+  cellBinNow = 0;
+  if (pairFloat) GatherPairCoordsF ();
+  else GatherPairCoords (cellList);
+  if (nThread > 1) {
+    EvalCellBlockCost ();
+    for (c = 0; c < nCellColor; c ++) {
+      SetThreadTasks (cellColorStart[c + 1] - cellColorStart[c], 1,
+         cellBlockCost + cellColorStart[c], cellBlockTime + cellColorStart[c]);
+      THREAD_PROC_LOOP (ComputeForcesT, c);
+    }
+  } else {
+    for (m1 = 0; m1 < VProd (cells); m1 ++) {
+      if (pairFloat) PairCellF (0, m1, cellBuf[0]);
+      else PairCell (0, m1, cellBuf[0]);
+    }
   }
-  DO_MOL VZero (mol[n].ra);
-  uSum = 0.;
-  virSum = 0.;
-  for (m1z = 0; m1z < cells.z; m1z ++) {
-    for (m1y = 0; m1y < cells.y; m1y ++) {
-      for (m1x = 0; m1x < cells.x; m1x ++) {
-        VSet (m1v, m1x, m1y, m1z);
-        m1 = VLinear (m1v, cells) + nMol;
-        for (offset = 0; offset < N_OFFSET; offset ++) {
-          VAdd (m2v, m1v, vOff[offset]);
-          VZero (shift);
-          VCellWrapAll ();
-          m2 = VLinear (m2v, cells) + nMol;
-          DO_CELL (j1, m1) {
-            DO_CELL (j2, m2) {
-              if (m1 != m2 || j2 < j1) {
-                VSub (dr, mol[j1].r, mol[j2].r);
-                VVSub (dr, shift);
-                rr = VLenSq (dr);
-                if (rr < rrCut) {
-                  rri = 1. / rr;
-                  rri3 = Cube (rri);
-                  fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
-                  uVal = 4. * rri3 * (rri3 - 1.) + 1.;
-                  VVSAdd (mol[j1].ra, fcVal, dr);
-                  VVSAdd (mol[j2].ra, - fcVal, dr);
-                  uSum += uVal;
-                  virSum += fcVal * rr;
-                }
-              }
-            }
-          }
-        }
-      }
+  ScatterPairAccels (cellList);
+  uSum = pairUSum;
+  virSum = pairVirSum;
+}
+
+/* the blocks of cells of one color are distributed among the threads
+   as tasks, and the colors are processed in turn */
+
+void *ComputeForcesT (void *tr)
+{
+  long ip;
+  int b, j, k, t;
+
+  QUERY_THREAD ();
+  THREAD_TASK_LOOP (t, j) {
+    b = cellColorStart[QUERY_STAGE] + j;
+    for (k = cellBlockStart[b]; k < cellBlockStart[b + 1]; k ++) {
+      if (pairFloat) PairCellF (ip, cellColorList[k], cellBuf[ip]);
+      else PairCell (ip, cellColorList[k], cellBuf[ip]);
     }
   }
+  return (NULL);
 }
 
 
-#define PCR4(r, ro, v, a, a1, a2, t)                        \
-   r.t = ro.t + deltaT * v.t +                              \
-   wr * (cr[0] * a.t + cr[1] * a1.t + cr[2] * a2.t)
-#define PCV4(r, ro, v, a, a1, a2, t)                        \
-   v.t = (r.t - ro.t) / deltaT +                            \
-   wv * (cv[0] * a.t + cv[1] * a1.t + cv[2] * a2.t)
-
-#define PR(t)                                               \
-   PCR4 (mol[n].r, mol[n].r, mol[n].rv,                     \
-   mol[n].ra, mol[n].ra1, mol[n].ra2, t)
-#define PRV(t)                                              \
-   PCV4 (mol[n].r, mol[n].ro, mol[n].rv,                    \
-   mol[n].ra, mol[n].ra1, mol[n].ra2, t)
-#define CR(t)                                               \
-   PCR4 (mol[n].r, mol[n].ro, mol[n].rvo,                   \
-   mol[n].ra, mol[n].ra1, mol[n].ra2, t)
-#define CRV(t)                                              \
-   PCV4 (mol[n].r, mol[n].ro, mol[n].rv,                    \
-   mol[n].ra, mol[n].ra1, mol[n].ra2, t)
+/* the predictor also applies the periodic boundaries and finds the
+   new cells (unless the cells are to be rebuilt from scratch), the
+   corrector also applies the boundaries and accumulates the sums
+   needed by EvalProps */
 
 void PredictorStep ()
 {
-  real cr[] = {19.,-10.,3.}, cv[] = {27.,-22.,7.}, div = 24., wr, wv;
   int n;
 
-  wr = Sqr (deltaT) / div;
-  wv = deltaT / div;
   DO_MOL {
-    mol[n].ro = mol[n].r;
-    mol[n].rvo = mol[n].rv;
-    PR (x);
-    PRV (x);
-    PR (y);
-    PRV (y);
-    PR (z);
-    PRV (z);
-    mol[n].ra2 = mol[n].ra1;
-    mol[n].ra1 = mol[n].ra;
+    PC_PREDICT (n);
+    VWrapAll (mol[n].r);
+    if (cellBinNow) continue;
+    if (cellIncr) CELL_MOVE_TRACK (mol[n].r, n)
+    else CELL_INDEX (cellOf[n], mol[n].r);
   }
 }
 
 void CorrectorStep ()
 {
-  real cr[] = {3.,10.,-1.}, cv[] = {7.,6.,-1.}, div = 24., wr, wv;
   int n;
 
-  wr = Sqr (deltaT) / div;
-  wv = deltaT / div;
+  VZero (vSum);
+  vvSum = 0.;
   DO_MOL {
-    CR (x);
-    CRV (x);
-    CR (y);
-    CRV (y);
-    CR (z);
-    CRV (z);
+    PC_CORRECT (n);
+    VWrapAll (mol[n].r);
+    VVAdd (vSum, mol[n].rv);
+    vvSum += VLenSq (mol[n].rv);
   }
 }
 
 
-void ApplyBoundaryCond ()
-{
-  int n;
-
-  DO_MOL VWrapAll (mol[n].r);
-}
-
-
 void AdjustInitTemp ()
 {
   real vFac;
@@ -294,26 +292,12 @@ void InitAccels ()
 {
   int n;
 
-  DO_MOL {
-    VZero (mol[n].ra);
-    VZero (mol[n].ra1);
-    VZero (mol[n].ra2);
-  }
+  DO_MOL VZero (mol[n].ra);
 }
 
 
 void EvalProps ()
 {
-  real vv, vvMax;
-  int n;
-
-  VZero (vSum);
-  vvSum = 0.;
-  DO_MOL {
-    VVAdd (vSum, mol[n].rv);
-    vv = VLenSq (mol[n].rv);
-    vvSum += vv;
-  }
   kinEnergy.val = 0.5 * vvSum / nMol;
   totEnergy.val = kinEnergy.val + uSum / nMol;
   pressure.val = density * (vvSum + virSum) / (nMol * NDIM);
@@ -351,4 +335,9 @@ void PrintSummary (FILE *fp)
 #include "in_rand.c"
 #include "in_errexit.c"
 #include "in_namelist.c"
+#include "in_cellbin.c"
+#include "in_thread.c"
+#include "in_reorder.c"
+#include "in_pairforce.c"
+#include "in_gearpc.c"
 
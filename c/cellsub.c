@@ -27,6 +27,10 @@
 
 
 #include "in_mddefs.h"
+#include "in_cellbin.h"
+#include "in_thread.h"
+#include "in_reorder.h"
+#include "in_pairforce.h"
 #include "in_debug.h"
 
 typedef struct {
@@ -40,21 +44,35 @@ real deltaT, density, rCut, temperature, timeNow, uSum, velMag, vvSum;
 Prop kinEnergy, totEnergy;
 int moreCycles, nMol, stepAvg, stepCount, stepEquil, stepLimit;
 VecI cells;
-int *cellList;
+int **cellBuf, cellBinNow, cellIncr;
 real virSum;
 Prop pressure;
 real kinEnInitSum;
-int stepInitlzTemp;
+int countEnergy, stepEnergy, stepInitlzTemp;
+char pairLaw[NAME_S_LEN];
+int pairFloat, pairTabSize;
 
 NameList nameList[] = {
+  NameI (cellDiv),
+  NameI (cellIncr),
   NameR (deltaT),
   NameR (density),
   NameI (initUcell),
+  NameI (nThread),
+  NameI (pairFloat),
+  NameS (pairLaw),
+  NameI (pairTabSize),
+  NameI (reorderCurve),
   NameI (stepAvg),
+  NameI (stepEnergy),
   NameI (stepEquil),
   NameI (stepInitlzTemp),
   NameI (stepLimit),
+  NameI (stepReorder),
   NameR (temperature),
+  NameI (threadSpin),
+  NameI (threadStats),
+  NameI (threadSteal),
 };
 
 
@@ -69,6 +87,7 @@ int main (int argc, char **argv)
     SingleStep ();
     if (stepCount >= stepLimit) moreCycles = 0;
   }
+  if (threadStats) PrintThreadStats (stdout);
 }
 
 
@@ -77,7 +96,11 @@ void SingleStep ()
   ++ stepCount;
   timeNow = stepCount * deltaT;
   LeapfrogStep (1);
-  ApplyBoundaryCond ();
+  if (stepReorder > 0 && stepCount % stepReorder == 0) {
+    ReorderMols ();
+    cellBinNow = 1;
+  }
+  pairForceOnly = ! EnergyStep ();
   ComputeForces ();
   LeapfrogStep (2);
   EvalProps ();
@@ -93,86 +116,101 @@ void SingleStep ()
 void SetupJob ()
 {
   AllocArrays ();
+  PrintPairTab (stdout);
   stepCount = 0;
   InitCoords ();
   InitVels ();
   InitAccels ();
   AccumProps (0);
   kinEnInitSum = 0.;
+  cellBinNow = 1;
 }
 
 void SetParams ()
 {
-  rCut = pow (2., 1./6.);
+  rCut = SetPairLaw (pairLaw);
   VSCopy (region, 1. / pow (density, 1./3.), initUcell);
   nMol = VProd (initUcell);
   velMag = sqrt (NDIM * (1. - 1. / nMol) * temperature);
-  VSCopy (cells, 1. / rCut, region);
+  if (stepEnergy <= 0) stepEnergy = Max (stepAvg / 10, 1);
+  cellDiv = Max (cellDiv, 1);
+  VSCopy (cells, cellDiv / rCut, region);
+  nThread = Min (nThread, PAIR_THREAD_MAX);
 }
 
 void AllocArrays ()
 {
+  int k;
+
   AllocMem (mol, nMol, Mol);
-  AllocMem (cellList, VProd (cells) + nMol, int);
+  AllocReorder ();
+  AllocCellBins (VProd (cells), nMol);
+  if (cellIncr) AllocCellMoves (VProd (cells), nMol);
+  InitThreads ();
+  AllocMem2 (cellBuf, nThread, nMol, int);
+  SetCellStencil (rCut);
+  if (nThread > 1) SetCellColors ();
+  AllocMemS (rS, nMol);
+  AllocMemS (raS, nMol);
+  BuildPairTab (pairTabSize);
+  if (pairTabLen > 0) pairFloat = 0;
+  if (pairFloat) AllocPairFloat (nMol, nThread);
 }
 
 
 void ComputeForces ()
 {
-  VecR dr, invWid, rs, shift;
-  VecI cc, m1v, m2v, vOff[] = OFFSET_VALS;
-  real fcVal, rr, rrCut, rri, rri3, uVal;
-  int c, j1, j2, m1, m1x, m1y, m1z, m2, n, offset;
-
-  rrCut = Sqr (rCut);
-  VDiv (invWid, cells, region);
-  for (n = nMol; n < nMol + VProd (cells); n ++) cellList[n] = -1;
-  DO_MOL {
-    VSAdd (rs, mol[n].r, 0.5, region);
-    VMul (cc, rs, invWid);
-    c = VLinear (cc, cells) + nMol;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
+  int c, m1;
+
+  if (cellBinNow) BIN_CELLS (mol, nMol);
+  else if (cellIncr) UpdateCellBins (nMol, VProd (cells));
+  else SortCellBins (nMol, VProd (cells));
+  cellBinNow = 0;
+  if (pairFloat) GatherPairCoordsF ();
+  else GatherPairCoords (cellList);
+  if (nThread > 1) {
+    EvalCellBlockCost ();
+    for (c = 0; c < nCellColor; c ++) {
+      SetThreadTasks (cellColorStart[c + 1] - cellColorStart[c], 1,
+         cellBlockCost + cellColorStart[c], cellBlockTime + cellColorStart[c]);
+      THREAD_PROC_LOOP (ComputeForcesT, c);
+    }
+  } else {
+    for (m1 = 0; m1 < VProd (cells); m1 ++) {
+      if (pairFloat) PairCellF (0, m1, cellBuf[0]);
+      else PairCell (0, m1, cellBuf[0]);
+    }
   }
-  DO_MOL VZero (mol[n].ra);
-  uSum = 0.;
-  virSum = 0.;
-  for (m1z = 0; m1z < cells.z; m1z ++) {
-    for (m1y = 0; m1y < cells.y; m1y ++) {
-      for (m1x = 0; m1x < cells.x; m1x ++) {
-        VSet (m1v, m1x, m1y, m1z);
-        m1 = VLinear (m1v, cells) + nMol;
-        for (offset = 0; offset < N_OFFSET; offset ++) {
-          VAdd (m2v, m1v, vOff[offset]);
-          VZero (shift);
-          VCellWrapAll ();
-          m2 = VLinear (m2v, cells) + nMol;
-          DO_CELL (j1, m1) {
-            DO_CELL (j2, m2) {
-              if (m1 != m2 || j2 < j1) {
-                VSub (dr, mol[j1].r, mol[j2].r);
-                VVSub (dr, shift);
-                rr = VLenSq (dr);
-                if (rr < rrCut) {
-                  rri = 1. / rr;
-                  rri3 = Cube (rri);
-                  fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
-                  uVal = 4. * rri3 * (rri3 - 1.) + 1.;
-                  VVSAdd (mol[j1].ra, fcVal, dr);
-                  VVSAdd (mol[j2].ra, - fcVal, dr);
-                  uSum += uVal;
-                  virSum += fcVal * rr;
-                }
-              }
-            }
-          }
-        }
-      }
+  ScatterPairAccels (cellList);
+  uSum = pairUSum;
+  virSum = pairVirSum;
+}
+
+/* the blocks of cells of one color are distributed among the threads
+   as tasks, and the colors are processed in turn */
+
+void *ComputeForcesT (void *tr)
+{
+  long ip;
+  int b, j, k, t;
+
+  QUERY_THREAD ();
+  THREAD_TASK_LOOP (t, j) {
+    b = cellColorStart[QUERY_STAGE] + j;
+    for (k = cellBlockStart[b]; k < cellBlockStart[b + 1]; k ++) {
+      if (pairFloat) PairCellF (ip, cellColorList[k], cellBuf[ip]);
+      else PairCell (ip, cellColorList[k], cellBuf[ip]);
     }
   }
+  return (NULL);
 }
 
 
+/* each part is a single pass over the particles: the first also
+   applies the periodic boundaries and finds the new cells (unless the
+   cells are to be rebuilt from scratch), the second also accumulates
+   the sums needed by EvalProps */
+
 void LeapfrogStep (int part)
 {
   int n;
@@ -181,18 +219,32 @@ void LeapfrogStep (int part)
     DO_MOL {
       VVSAdd (mol[n].rv, 0.5 * deltaT, mol[n].ra);
       VVSAdd (mol[n].r, deltaT, mol[n].rv);
+      VWrapAll (mol[n].r);
+      if (cellBinNow) continue;
+      if (cellIncr) CELL_MOVE_TRACK (mol[n].r, n)
+      else CELL_INDEX (cellOf[n], mol[n].r);
     }
   } else {
-    DO_MOL VVSAdd (mol[n].rv, 0.5 * deltaT, mol[n].ra);
+    VZero (vSum);
+    vvSum = 0.;
+    DO_MOL {
+      VVSAdd (mol[n].rv, 0.5 * deltaT, mol[n].ra);
+      VVAdd (vSum, mol[n].rv);
+      vvSum += VLenSq (mol[n].rv);
+    }
   }
 }
 
 
-void ApplyBoundaryCond ()
-{
-  int n;
+/* the pair energy and virial only feed the totEnergy and pressure
+   averages, so they are needed every stepEnergy steps (by default about
+   ten samples per averaging interval) and on the step that closes each
+   interval; the rescaling in AdjustInitTemp uses only the kinetic
+   energy, which LeapfrogStep evaluates on every step */
 
-  DO_MOL VWrapAll (mol[n].r);
+int EnergyStep ()
+{
+  return (stepCount % stepAvg == 0 || stepCount % stepEnergy == 0);
 }
 
 
@@ -256,16 +308,6 @@ void InitAccels ()
 
 void EvalProps ()
 {
-  real vv, vvMax;
-  int n;
-
-  VZero (vSum);
-  vvSum = 0.;
-  DO_MOL {
-    VVAdd (vSum, mol[n].rv);
-    vv = VLenSq (mol[n].rv);
-    vvSum += vv;
-  }
   kinEnergy.val = 0.5 * vvSum / nMol;
   totEnergy.val = kinEnergy.val + uSum / nMol;
   pressure.val = density * (vvSum + virSum) / (nMol * NDIM);
@@ -278,14 +320,18 @@ void AccumProps (int icode)
     PropZero (totEnergy);
     PropZero (kinEnergy);
     PropZero (pressure);
+    countEnergy = 0;
   } else if (icode == 1) {
-    PropAccum (totEnergy);
+    if (! pairForceOnly) {
+      PropAccum (totEnergy);
+      PropAccum (pressure);
+      ++ countEnergy;
+    }
     PropAccum (kinEnergy);
-    PropAccum (pressure);
   } else if (icode == 2) {
-    PropAvg (totEnergy, stepAvg);
+    PropAvg (totEnergy, countEnergy);
     PropAvg (kinEnergy, stepAvg);
-    PropAvg (pressure, stepAvg);
+    PropAvg (pressure, countEnergy);
   }
 }
 
@@ -303,4 +349,8 @@ void PrintSummary (FILE *fp)
 #include "in_rand.c"
 #include "in_errexit.c"
 #include "in_namelist.c"
+#include "in_cellbin.c"
+#include "in_thread.c"
+#include "in_reorder.c"
+#include "in_pairforce.c"
 #include "in_debug.c"
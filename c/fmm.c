@@ -28,6 +28,8 @@
 #define NDIM  3
 
 #include "in_mddefs.h"
+#include "in_cellbin.h"
+#include "in_nebrlist.h"
 #include "in_debug.h"
 
 typedef struct {
@@ -42,9 +44,9 @@ real deltaT, density, rCut, temperature, timeNow, uSum, velMag, vvSum;
 Prop kinEnergy, potEnergy, totEnergy;
 int moreCycles, nMol, stepAvg, stepCount, stepEquil, stepLimit;
 VecI cells;
-int *cellList;
-real dispHi, rNebrShell;
+real rNebrShell;
 int *nebrTab, nebrNow, nebrTabFac, nebrTabLen, nebrTabMax;
+int *nebrTabPtr;
 real **histRdf, **cumRdf, rangeRdf;
 int countRdf, limitRdf, sizeHistRdf, stepRdf;
 real kinEnInitSum;
@@ -96,6 +98,7 @@ int main (int argc, char **argv)
     SingleStep ();
     if (stepCount >= stepLimit) moreCycles = 0;
   }
+  PrintNebrStats (stdout, stepCount);
 }
 
 
@@ -111,7 +114,6 @@ void SingleStep ()
   if (profLevel == 1) TimerStart(&tm);
   if (nebrNow) {
     nebrNow = 0;
-    dispHi = 0.;
     BuildNebrList ();
   }
   if (profLevel == 1) printf("buildNebrList: %f\n", TimerStop(&tm));
@@ -178,8 +180,10 @@ void AllocArrays ()
   int k, n;
 
   AllocMem (mol, nMol, Mol);
-  AllocMem (cellList, VProd (cells) + nMol, int);
-  AllocMem (nebrTab, 2 * nebrTabMax, int);
+  AllocCellBins (VProd (cells), nMol);
+  AllocMem (nebrTab, nebrTabMax, int);
+  AllocMem (nebrTabPtr, nMol + 1, int);
+  AllocMem (nebrRefR, nMol, VecR);
   AllocMem (mpCell, maxLevel + 1, MpCell *);
   maxCellsEdge = 2;
   for (n = 2; n <= maxLevel; n ++) {
@@ -193,86 +197,53 @@ void AllocArrays ()
 }
 
 
+#define NEBR_CELL_WRAP                                      \
+   if (m2v.x < 0 || m2v.x >= cells.x ||                     \
+       m2v.y < 0 || m2v.y >= cells.y ||                     \
+                    m2v.z >= cells.z) continue
+
 void BuildNebrList ()
 {
   struct timeval tm;
-  VecR dr, invWid, rs;
-  VecI cc, m1v, m2v, vOff[] = OFFSET_VALS;
-  real rrNebr;
-  int c, j1, j2, m1, m1x, m1y, m1z, m2, n, offset;
 
-  rrNebr = Sqr (rCut + rNebrShell);
-  VDiv (invWid, cells, region);
-  
-  for (n = nMol; n < nMol + VProd (cells); n ++) cellList[n] = -1;
   if (profLevel == 2) TimerStart(&tm);
-  DO_MOL {
-    VSAdd (rs, mol[n].r, 0.5, region);
-    VMul (cc, rs, invWid);
-    c = VLinear (cc, cells) + nMol;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
-  }
+  BIN_CELLS (mol, nMol);
   if (profLevel == 2) printf("buildNebrList:cellList: %f\n", TimerStop(&tm));;
   
   if (profLevel == 2) TimerStart(&tm);
-  nebrTabLen = 0;
-  for (m1z = 0; m1z < cells.z; m1z ++) {
-    for (m1y = 0; m1y < cells.y; m1y ++) {
-      for (m1x = 0; m1x < cells.x; m1x ++) {
-        VSet (m1v, m1x, m1y, m1z);
-        m1 = VLinear (m1v, cells) + nMol;
-        for (offset = 0; offset < N_OFFSET; offset ++) {
-          VAdd (m2v, m1v, vOff[offset]);
-          if (m2v.x < 0 || m2v.x >= cells.x ||
-              m2v.y < 0 || m2v.y >= cells.y ||
-                           m2v.z >= cells.z) continue;
-          m2 = VLinear (m2v, cells) + nMol;
-          DO_CELL (j1, m1) {
-            DO_CELL (j2, m2) {
-              if (m1 != m2 || j2 < j1) {
-                VSub (dr, mol[j1].r, mol[j2].r);
-                if (VLenSq (dr) < rrNebr) {
-                  if (nebrTabLen >= nebrTabMax)
-                     ErrExit (ERR_TOO_MANY_NEBRS);
-                  nebrTab[2 * nebrTabLen] = j1;
-                  nebrTab[2 * nebrTabLen + 1] = j2;
-                  ++ nebrTabLen;
-                }
-              }
-            }
-          }
-        }
-      }
-    }
-  }
+  BUILD_NEBR_TAB (mol, nMol, rCut + rNebrShell);
+  SAVE_NEBR_REF (mol, nMol);
   if (profLevel == 2) printf("buildNebrList:nebrTab: %f\n", TimerStop(&tm));;
 }
 
 
 void ComputeForces ()
 {
-  VecR dr;
+  VecR dr, fi, ri;
   real fcVal, rr, rrCut, rri, rri3, uVal;
   int j1, j2, n;
 
   rrCut = Sqr (rCut);
   DO_MOL VZero (mol[n].ra);
   uSum = 0.;
-  for (n = 0; n < nebrTabLen; n ++) {
-    j1 = nebrTab[2 * n];
-    j2 = nebrTab[2 * n + 1];
-    VSub (dr, mol[j1].r, mol[j2].r);
-    rr = VLenSq (dr);
-    if (rr < rrCut) {
-      rri = 1. / rr;
-      rri3 = Cube (rri);
-      fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
-      uVal = 4. * rri3 * (rri3 - 1.) + 1.;
-      VVSAdd (mol[j1].ra, fcVal, dr);
-      VVSAdd (mol[j2].ra, - fcVal, dr);
-      uSum += uVal;
+  for (j1 = 0; j1 < nMol; j1 ++) {
+    ri = mol[j1].r;
+    VZero (fi);
+    for (n = nebrTabPtr[j1]; n < nebrTabPtr[j1 + 1]; n ++) {
+      j2 = nebrTab[n];
+      VSub (dr, ri, mol[j2].r);
+      rr = VLenSq (dr);
+      if (rr < rrCut) {
+        rri = 1. / rr;
+        rri3 = Cube (rri);
+        fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
+        uVal = 4. * rri3 * (rri3 - 1.) + 1.;
+        VVSAdd (fi, fcVal, dr);
+        VVSAdd (mol[j2].ra, - fcVal, dr);
+        uSum += uVal;
+      }
     }
+    VVAdd (mol[j1].ra, fi);
   }
 }
 
@@ -823,10 +794,13 @@ void LeapfrogStep (int part)
   int n;
 
   if (part == 1) {
+    NEBR_DISP_ZERO;
     DO_MOL {
       VVSAdd (mol[n].rv, 0.5 * deltaT, mol[n].ra);
       VVSAdd (mol[n].r, deltaT, mol[n].rv);
+      NEBR_DISP_TRACK (mol[n].r, n);
     }
+    if (NEBR_DISP_OVER (rNebrShell)) nebrNow = 1;
   } else {
     DO_MOL VVSAdd (mol[n].rv, 0.5 * deltaT, mol[n].ra);
   }
@@ -893,20 +867,16 @@ void InitAccels ()
 
 void EvalProps ()
 {
-  real vv, vvMax;
+  real vv;
   int n;
 
   VZero (vSum);
   vvSum = 0.;
-  vvMax = 0.;
   DO_MOL {
     VVAdd (vSum, mol[n].rv);
     vv = VLenSq (mol[n].rv);
     vvSum += vv;
-    vvMax = Max (vvMax, vv);
   }
-  dispHi += sqrt (vvMax) * deltaT;
-  if (dispHi > 0.5 * rNebrShell) nebrNow = 1;
   kinEnergy.val = 0.5 * vvSum / nMol;
   totEnergy.val = kinEnergy.val + uSum / nMol;
 }
@@ -1002,4 +972,6 @@ void PrintRdf (FILE *fp)
 #include "in_rand.c"
 #include "in_errexit.c"
 #include "in_namelist.c"
+#include "in_cellbin.c"
+#include "in_nebrlist.c"
 #include "in_debug.c"
@@ -0,0 +1,302 @@
+
+/* cell occupancy held in CSR form: the members of cell c are
+   cellList[cellStart[c] ... cellStart[c + 1] - 1], in increasing order;
+   cellOf[n] is the cell containing particle n */
+
+void AllocCellBins (int nc, int np)
+{
+  AllocMem (cellStart, nc + 1, int);
+  AllocMem (cellList, np, int);
+  AllocMem (cellOf, np, int);
+}
+
+void SortCellBins (int np, int nc)
+{
+  int c, n;
+
+  for (c = 0; c <= nc; c ++) cellStart[c] = 0;
+  for (n = 0; n < np; n ++) ++ cellStart[cellOf[n] + 1];
+  for (c = 0; c < nc; c ++) cellStart[c + 1] += cellStart[c];
+  for (n = 0; n < np; n ++) cellList[cellStart[cellOf[n]] ++] = n;
+  for (c = nc; c > 0; c --) cellStart[c] = cellStart[c - 1];
+  cellStart[0] = 0;
+}
+
+/* bin np particles whose coordinates are found at intervals of stride
+   bytes starting at r (see BIN_CELLS) */
+
+void BinCells (VecR *r, int stride, int np)
+{
+  VecR invWid, rs;
+  VecI cc;
+  int n;
+
+  VDiv (invWid, cells, region);
+  cellInvWid = invWid;
+  for (n = 0; n < np; n ++) {
+    VSAdd (rs, *(VecR *) ((char *) r + n * stride), 0.5, region);
+    VMul (cc, rs, invWid);
+    cellOf[n] = VLinear (cc, cells);
+  }
+  SortCellBins (np, VProd (cells));
+  for (n = 0; n < nCellMove; n ++) cellMoveFrom[cellMoveList[n]] = -1;
+  nCellMove = 0;
+}
+
+void AllocCellMoves (int nc, int np)
+{
+  int n;
+
+  AllocMem (cellListB, np, int);
+  AllocMem (cellMark, nc, int);
+  AllocMem (cellMoveFrom, np, int);
+  AllocMem (cellMoveList, np, int);
+  for (n = 0; n < nc; n ++) cellMark[n] = 0;
+  for (n = 0; n < np; n ++) cellMoveFrom[n] = -1;
+  nCellMove = 0;
+}
+
+/* apply the changes noted by CELL_MOVE_TRACK; the cells are copied in
+   order to cellListB (which then replaces cellList), runs of unaltered
+   cells as single blocks, and the arrivals in each altered cell are
+   merged with the remaining members, so the result is the same as
+   from BinCells; the counting sort is used instead if many particles
+   have moved */
+
+void UpdateCellBins (int np, int nc)
+{
+  int *t, ia, k, kBeg, kEnd, kRun, m, n, nm, nOut;
+
+  nm = 0;
+  for (k = 0; k < nCellMove; k ++) {
+    n = cellMoveList[k];
+    if (cellMoveFrom[n] != cellOf[n]) {
+      cellMark[cellMoveFrom[n]] = 1;
+      cellMoveList[nm ++] = n;
+    }
+    cellMoveFrom[n] = -1;
+  }
+  nCellMove = 0;
+  if (nm == 0) return;
+  if (nm > np / 8) {
+    SortCellBins (np, nc);
+    for (m = 0; m < nc; m ++) cellMark[m] = 0;
+    return;
+  }
+  qsort (cellMoveList, nm, sizeof (int), CellMoveCmp);
+  ia = 0;
+  nOut = 0;
+  kRun = 0;
+  kEnd = cellStart[0];
+  for (m = 0; m < nc; m ++) {
+    kBeg = kEnd;
+    kEnd = cellStart[m + 1];
+    if (! cellMark[m] && (ia == nm || cellOf[cellMoveList[ia]] != m)) {
+      cellStart[m] = nOut + kBeg - kRun;
+      continue;
+    }
+    memcpy (cellListB + nOut, cellList + kRun, (kBeg - kRun) * sizeof (int));
+    nOut += kBeg - kRun;
+    cellStart[m] = nOut;
+    cellMark[m] = 0;
+    for (k = kBeg; k < kEnd; k ++) {
+      n = cellList[k];
+      if (cellOf[n] != m) continue;
+      while (ia < nm && cellOf[cellMoveList[ia]] == m &&
+         cellMoveList[ia] < n) cellListB[nOut ++] = cellMoveList[ia ++];
+      cellListB[nOut ++] = n;
+    }
+    while (ia < nm && cellOf[cellMoveList[ia]] == m)
+       cellListB[nOut ++] = cellMoveList[ia ++];
+    kRun = kEnd;
+  }
+  memcpy (cellListB + nOut, cellList + kRun, (kEnd - kRun) * sizeof (int));
+  cellStart[nc] = np;
+  t = cellList;
+  cellList = cellListB;
+  cellListB = t;
+}
+
+int CellMoveCmp (const void *a, const void *b)
+{
+  int c1, c2, n1, n2;
+
+  n1 = *(int *) a;
+  n2 = *(int *) b;
+  c1 = cellOf[n1];
+  c2 = cellOf[n2];
+  return ((c1 != c2) ? c1 - c2 : n1 - n2);
+}
+
+/* half-shell stencil for cells (cellDiv across the interaction range
+   if cellDiv > 1) that can hold particles within distance rReach of
+   each other: cellOff[0 ... nCellOff - 1] are the offsets of the cells
+   whose nearest points lie within rReach of cell 0, restricted to those
+   whose last nonzero component is positive (the rest are their
+   negatives), with offset 0 first; if the cells are at least rReach
+   wide they are ordered by the last component, then by ring and angle
+   about it, reproducing OFFSET_VALS, otherwise by z, y and x; runs of
+   successive offsets along x form rows of adjacent cells, whose
+   members occupy consecutive slots (cellOffRow holds the linear offset
+   of the first cell of each row, cellOffRowLen the number of cells);
+   regenerated only if rReach or the cells change */
+
+void SetCellStencil (real rReach)
+{
+  VecR w;
+  VecI v, vw;
+  real d, dd, key[CELL_OFF_MAX], t;
+  int fine, j, k, n, nv, ok;
+
+  ok = (nCellOff > 0 && rReach == cellOffRange);
+  for (k = 0; k < NDIM; k ++) {
+    if (VComp (cells, k) != VComp (cellOffCells, k) ||
+       VComp (region, k) != VComp (cellOffRegion, k)) ok = 0;
+  }
+  if (ok) return;
+  if (! cellOff) {
+    AllocMem (cellOff, CELL_OFF_MAX, VecI);
+    AllocMem (cellOffRow, CELL_OFF_MAX, int);
+    AllocMem (cellOffRowLen, CELL_OFF_MAX, int);
+  }
+  VDiv (w, region, cells);
+  fine = 0;
+  for (k = 0; k < NDIM; k ++) {
+    VComp (cellOffReach, k) = ceil (rReach / VComp (w, k) - 1e-10);
+    if (VComp (cellOffReach, k) > 1) fine = 1;
+    if (cellDiv > 1 && VComp (cells, k) < 2 * VComp (cellOffReach, k) + 1)
+       ErrExit (ERR_TOO_FEW_CELLS);
+    VComp (vw, k) = 2 * VComp (cellOffReach, k) + 1;
+  }
+  nCellOff = 0;
+  nv = VProd (vw);
+  for (n = 0; n < nv; n ++) {
+    j = n;
+    for (k = 0; k < NDIM; k ++) {
+      VComp (v, k) = j % VComp (vw, k) - VComp (cellOffReach, k);
+      j /= VComp (vw, k);
+    }
+    for (k = NDIM - 1; k > 0 && VComp (v, k) == 0; k --);
+    if (VComp (v, k) < 0) continue;
+    dd = 0.;
+    for (k = 0; k < NDIM; k ++) {
+      d = (abs (VComp (v, k)) - 1) * VComp (w, k);
+      if (d > 0.) dd += Sqr (d);
+    }
+    if (dd >= Sqr (rReach)) continue;
+    if (nCellOff == CELL_OFF_MAX) ErrExit (ERR_TOO_MANY_CELLS);
+    if (fine) t = n;
+    else {
+      t = atan2 ((double) v.y, (double) v.x);
+      if (t < 0.) t += 2. * M_PI;
+      t += 10. * Max (abs (v.x), abs (v.y));
+#if NDIM == 3
+      t += 1000. * v.z;
+#endif
+    }
+    for (j = nCellOff; j > 0 && key[j - 1] > t; j --) {
+      key[j] = key[j - 1];
+      cellOff[j] = cellOff[j - 1];
+    }
+    key[j] = t;
+    cellOff[j] = v;
+    ++ nCellOff;
+  }
+  nCellOffRow = 0;
+  for (n = 0; n < nCellOff; n ++) {
+    VSub (v, cellOff[n], cellOff[Max (n - 1, 0)]);
+    if (n > 0 && v.x == 1 && VLinear (v, cells) == 1)
+       ++ cellOffRowLen[nCellOffRow - 1];
+    else {
+      cellOffRow[nCellOffRow] = VLinear (cellOff[n], cells);
+      cellOffRowLen[nCellOffRow] = 1;
+      ++ nCellOffRow;
+    }
+  }
+  cellOffCells = cells;
+  cellOffRegion = region;
+  cellOffRange = rReach;
+}
+
+/* cells are grouped into blocks along each axis, the number of blocks
+   being a multiple of the stride (3, or 2 for the last axis, because
+   of the half-shell stencil) unless there are too few cells, and the
+   blocks are colored by their indices modulo the stride; since blocks
+   are at least as wide as the stencil reach (SetCellStencil must be
+   called first), no two blocks of the same color update forces in a
+   common cell; cellColorList holds the cells ordered by color and
+   block, the cells of (reordered) block b start at cellBlockStart[b]
+   and the blocks of color c at cellColorStart[c] */
+
+void SetCellColors ()
+{
+  VecI bv, cv, mv, nbv, sv;
+  int b, c, k, m, nb, nc, sList[] = COLOR_STRIDE, *blockRank;
+
+  for (k = 0; k < NDIM; k ++) {
+    VComp (sv, k) = sList[k];
+    m = VComp (cells, k) / VComp (cellOffReach, k);
+    VComp (nbv, k) = (m >= sList[k]) ? m / sList[k] * sList[k] : 1;
+  }
+  nb = VProd (nbv);
+  nc = VProd (cells);
+  nCellColor = VProd (sv);
+  nCellBlock = nb;
+  AllocMem (cellColorStart, nCellColor + 1, int);
+  AllocMem (cellBlockStart, nb + 1, int);
+  AllocMem (cellBlockCost, nb + 1, int);
+  AllocMem (cellBlockTime, nb, real);
+  AllocMem (cellColorList, nc, int);
+  AllocMem (blockRank, nb, int);
+  for (c = 0; c <= nCellColor; c ++) cellColorStart[c] = 0;
+  for (b = 0; b < nb; b ++) {
+    m = b;
+    for (k = 0; k < NDIM; k ++) {
+      VComp (cv, k) = m % VComp (nbv, k) % VComp (sv, k);
+      m /= VComp (nbv, k);
+    }
+    blockRank[b] = VLinear (cv, sv);
+    ++ cellColorStart[blockRank[b] + 1];
+  }
+  for (c = 0; c < nCellColor; c ++) cellColorStart[c + 1] += cellColorStart[c];
+  for (b = 0; b < nb; b ++) blockRank[b] = cellColorStart[blockRank[b]] ++;
+  for (c = nCellColor; c > 0; c --) cellColorStart[c] = cellColorStart[c - 1];
+  cellColorStart[0] = 0;
+  for (b = 0; b <= nb; b ++) cellBlockStart[b] = 0;
+  for (b = 0; b < nb; b ++) cellBlockTime[b] = 0.;
+  for (m = 0; m < nc; m ++) {
+    VCellVec (mv, m);
+    for (k = 0; k < NDIM; k ++)
+       VComp (bv, k) = VComp (mv, k) * VComp (nbv, k) / VComp (cells, k);
+    ++ cellBlockStart[blockRank[VLinear (bv, nbv)] + 1];
+  }
+  for (b = 0; b < nb; b ++) cellBlockStart[b + 1] += cellBlockStart[b];
+  for (m = 0; m < nc; m ++) {
+    VCellVec (mv, m);
+    for (k = 0; k < NDIM; k ++)
+       VComp (bv, k) = VComp (mv, k) * VComp (nbv, k) / VComp (cells, k);
+    cellColorList[cellBlockStart[blockRank[VLinear (bv, nbv)]] ++] = m;
+  }
+  for (b = nb; b > 0; b --) cellBlockStart[b] = cellBlockStart[b - 1];
+  cellBlockStart[0] = 0;
+  free (blockRank);
+}
+
+/* cumulative cost of the blocks (in color order), the cost of a cell
+   being taken as the square of its occupancy; this estimate is used
+   until the measured block times (cellBlockTime) are available */
+
+void EvalCellBlockCost ()
+{
+  int b, k, m, n;
+
+  cellBlockCost[0] = 0;
+  for (b = 0; b < nCellBlock; b ++) {
+    cellBlockCost[b + 1] = cellBlockCost[b];
+    for (k = cellBlockStart[b]; k < cellBlockStart[b + 1]; k ++) {
+      m = cellColorList[k];
+      n = cellStart[m + 1] - cellStart[m];
+      cellBlockCost[b + 1] += Sqr (n);
+    }
+  }
+}
@@ -0,0 +1,76 @@
+
+#ifndef CELL_BIN_DEFS
+
+#define CELL_BIN_DEFS
+
+#define CELL_OFF_MAX  200
+
+VecR cellInvWid, cellOffRegion;
+VecI *cellOff, cellOffCells, cellOffReach;
+real cellOffRange;
+int *cellList, *cellOf, *cellOffRow, *cellOffRowLen, *cellStart, cellDiv,
+   nCellOff, nCellOffRow;
+int *cellListB, *cellMark, *cellMoveFrom, *cellMoveList, nCellMove;
+real *cellBlockTime;
+int *cellBlockCost, *cellBlockStart, *cellColorList, *cellColorStart,
+   nCellBlock, nCellColor;
+
+#define DO_CELL(j, m)                                       \
+   for (int k_##j = cellStart[m]; k_##j < cellStart[(m) + 1] && \
+      ((j = cellList[k_##j]), 1); k_##j ++)
+#define DO_CELL_SLOT(k, m)                                  \
+   for (k = cellStart[m]; k < cellStart[(m) + 1]; k ++)
+#define CELL_EMPTY(m)  (cellStart[m] == cellStart[(m) + 1])
+
+/* the stencil of a cell satisfying CELL_INTERIOR does not wrap, so
+   its rows (cellOffRow) can be used */
+
+#define VCellIn(v, t)                                       \
+   ((v).t >= cellOffReach.t && (v).t < cells.t - cellOffReach.t)
+
+#if NDIM == 2
+#define VCellVec(v, c)                                      \
+   VSet (v, (c) % cells.x, (c) / cells.x)
+#define CELL_INTERIOR(v)                                    \
+   (VCellIn (v, x) && VCellIn (v, y))
+#else
+#define VCellVec(v, c)                                      \
+   VSet (v, (c) % cells.x, ((c) / cells.x) % cells.y,       \
+   (c) / (cells.x * cells.y))
+#define CELL_INTERIOR(v)                                    \
+   (VCellIn (v, x) && VCellIn (v, y) && VCellIn (v, z))
+#endif
+
+#if NDIM == 2
+#define COLOR_STRIDE  {3, 2}
+#else
+#define COLOR_STRIDE  {3, 3, 2}
+#endif
+
+#define BIN_CELLS(a, np)                                    \
+   BinCells (&(a)[0].r, sizeof ((a)[0]), np)
+
+/* particles changing cell are noted as the coordinates are updated
+   (after wrapping), and UpdateCellBins then only alters the cells
+   concerned; the first cell of each such particle since the last
+   update is kept in cellMoveFrom */
+
+#define CELL_INDEX(c, p)                                    \
+   {VecR rs_;                                               \
+   VecI cc_;                                                \
+   VSAdd (rs_, p, 0.5, region);                             \
+   VMul (cc_, rs_, cellInvWid);                             \
+   c = VLinear (cc_, cells);}
+#define CELL_MOVE_TRACK(p, n)                               \
+   {int c_;                                                 \
+   CELL_INDEX (c_, p);                                      \
+   if (c_ != cellOf[n]) {                                   \
+     if (cellMoveFrom[n] < 0) {                             \
+       cellMoveFrom[n] = cellOf[n];                         \
+       cellMoveList[nCellMove ++] = n;                      \
+     }                                                      \
+     cellOf[n] = c_;                                        \
+   }}
+
+#endif
+
@@ -0,0 +1,44 @@
+
+/* the history starts at zero, as if the particles had been at rest */
+
+void AllocGearPC (int np)
+{
+  int n;
+
+  AllocMemS (pcRa1, np);
+  AllocMemS (pcRa2, np);
+  AllocMemS (pcRo, np);
+  AllocMemS (pcRvo, np);
+  AllocMemS (pcTmp, np);
+  for (n = 0; n < np; n ++) {
+    VSZero (pcRa1, n);
+    VSZero (pcRa2, n);
+  }
+  pcWr = Sqr (deltaT) / 24.;
+  pcWv = deltaT / 24.;
+}
+
+/* the slots follow mol[] when it is reordered (slot n receives slot
+   perm[n], as in ReorderMols) */
+
+#define PC_PERMUTE(v, t)                                    \
+   for (n = 0; n < np; n ++) pcTmp.t[n] = (v).t[perm[n]];   \
+   p = (v).t;                                               \
+   (v).t = pcTmp.t;                                         \
+   pcTmp.t = p
+
+void PermuteGearPC (int *perm, int np)
+{
+  VecRS *pc[] = {&pcRa1, &pcRa2, &pcRo, &pcRvo};
+  real *p;
+  int k, n;
+
+  for (k = 0; k < 4; k ++) {
+    PC_PERMUTE (*pc[k], x);
+    PC_PERMUTE (*pc[k], y);
+#if NDIM == 3
+    PC_PERMUTE (*pc[k], z);
+#endif
+  }
+}
+
@@ -0,0 +1,54 @@
+
+#ifndef GEAR_PC_DEFS
+
+#define GEAR_PC_DEFS
+
+/* fourth-order Gear predictor-corrector; mol[] only holds r, rv and
+   ra, the values needed by the integrator alone (the two previous
+   accelerations, and the coordinates and velocities from before the
+   predictor) are held in SoA arrays, slot n belonging to mol[n]; the
+   updates of a particle are macros, so that the programs can do other
+   work (boundaries, cells, sums) in the same pass */
+
+#define PC_PRED_C(n, t)                                     \
+   pcRo.t[n] = mol[n].r.t,                                  \
+   pcRvo.t[n] = mol[n].rv.t,                                \
+   mol[n].r.t = pcRo.t[n] + deltaT * mol[n].rv.t +          \
+   pcWr * (19. * mol[n].ra.t - 10. * pcRa1.t[n] +           \
+   3. * pcRa2.t[n]),                                        \
+   mol[n].rv.t = (mol[n].r.t - pcRo.t[n]) / deltaT +        \
+   pcWv * (27. * mol[n].ra.t - 22. * pcRa1.t[n] +           \
+   7. * pcRa2.t[n]),                                        \
+   pcRa2.t[n] = pcRa1.t[n],                                 \
+   pcRa1.t[n] = mol[n].ra.t
+#define PC_CORR_C(n, t)                                     \
+   mol[n].r.t = pcRo.t[n] + deltaT * pcRvo.t[n] +           \
+   pcWr * (3. * mol[n].ra.t + 10. * pcRa1.t[n] -            \
+   pcRa2.t[n]),                                             \
+   mol[n].rv.t = (mol[n].r.t - pcRo.t[n]) / deltaT +        \
+   pcWv * (7. * mol[n].ra.t + 6. * pcRa1.t[n] -             \
+   pcRa2.t[n])
+
+#if NDIM == 2
+#define PC_PREDICT(n)                                       \
+   PC_PRED_C (n, x),                                        \
+   PC_PRED_C (n, y)
+#define PC_CORRECT(n)                                       \
+   PC_CORR_C (n, x),                                        \
+   PC_CORR_C (n, y)
+#else
+#define PC_PREDICT(n)                                       \
+   PC_PRED_C (n, x),                                        \
+   PC_PRED_C (n, y),                                        \
+   PC_PRED_C (n, z)
+#define PC_CORRECT(n)                                       \
+   PC_CORR_C (n, x),                                        \
+   PC_CORR_C (n, y),                                        \
+   PC_CORR_C (n, z)
+#endif
+
+VecRS pcRa1, pcRa2, pcRo, pcRvo, pcTmp;
+real pcWr, pcWv;
+
+#endif
+
@@ -17,7 +17,7 @@ typedef struct {
 
 #define MAT(a, n, i, j)  (a)[(i) + n * (j)]
 
-#define AllocMem(a, n, t)  a = (t *) malloc ((n) * sizeof (t))
+#define AllocMem(a, n, t)  a = (t *) MallocA ((n) * sizeof (t))
 
 #define AllocMem2(a, n1, n2, t)                             \
    AllocMem (a, n1, t *);                                   \
@@ -38,11 +38,12 @@ typedef struct {
 } MpCell;
 
 #include "in_vdefs.h"
+#include "in_mem.h"
+#include "in_soa.h"
 #include "in_namelist.h"
 #include "in_proto.h"
 
 #define DO_MOL  for (n = 0; n < nMol; n ++)
-#define DO_CELL(j, m)  for (j = cellList[m]; j >= 0; j = cellList[j])
 
 #define VWrap(v, t)                                         \
    if (v.t >= 0.5 * region.t)      v.t -= region.t;         \
@@ -63,12 +64,15 @@ typedef struct {
 
 #define VCellWrap(t)                                        \
    if (m2v.t >= cells.t) {                                  \
-     m2v.t = 0;                                             \
+     m2v.t -= cells.t;                                      \
      shift.t = region.t;                                    \
    } else if (m2v.t < 0) {                                  \
-     m2v.t = cells.t - 1;                                   \
+     m2v.t += cells.t;                                      \
      shift.t = - region.t;                                  \
    }
+#define VCellWrapIdx(t)                                     \
+   if (m2v.t >= cells.t) m2v.t -= cells.t;                  \
+   else if (m2v.t < 0) m2v.t += cells.t
 
 #if NDIM == 2
 
@@ -81,6 +85,9 @@ typedef struct {
 #define VCellWrapAll()                                      \
    {VCellWrap (x);                                          \
    VCellWrap (y);}
+#define VCellWrapIdxAll()                                   \
+   {VCellWrapIdx (x);                                       \
+   VCellWrapIdx (y);}
 #define OFFSET_VALS                                         \
    {{0,0}, {1,0}, {1,1}, {0,1}, {-1,1}}
 #define N_OFFSET  5
@@ -101,6 +108,10 @@ typedef struct {
    {VCellWrap (x);                                          \
    VCellWrap (y);                                           \
    VCellWrap (z);}
+#define VCellWrapIdxAll()                                   \
+   {VCellWrapIdx (x);                                       \
+   VCellWrapIdx (y);                                        \
+   VCellWrapIdx (z);}
 
 #define OFFSET_VALS                                           \
    { {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0}, {-1,1,0},            \
@@ -119,7 +130,7 @@ typedef struct {
 #define PropZero(v)  v.sum = v.sum2 = 0.
 #define PropAccum(v)  v.sum += v.val, v.sum2 += Sqr (v.val)
 #define PropAvg(v, n) \
-   v.sum /= n, v.sum2 = sqrt (Max (v.sum2 / n - Sqr (v.sum), 0.))
+   v.sum /= (n), v.sum2 = sqrt (Max (v.sum2 / (n) - Sqr (v.sum), 0.))
 #define PropEst(v)  v.sum, v.sum2
 
 typedef struct {
@@ -150,16 +161,18 @@ char *progId = "md";
 
 enum {ERR_NONE, ERR_BOND_SNAPPED, ERR_CHECKPT_READ, ERR_CHECKPT_WRITE,
    ERR_COPY_BUFF_FULL, ERR_EMPTY_EVPOOL, ERR_MSG_BUFF_FULL,
-   ERR_OUTSIDE_REGION, ERR_SNAP_READ, ERR_SNAP_WRITE,
-   ERR_SUBDIV_UNFIN, ERR_TOO_MANY_CELLS, ERR_TOO_MANY_COPIES,
-   ERR_TOO_MANY_LAYERS, ERR_TOO_MANY_LEVELS, ERR_TOO_MANY_MOLS,
-   ERR_TOO_MANY_MOVES, ERR_TOO_MANY_NEBRS, ERR_TOO_MANY_REPLICAS};
+   ERR_NEBR_ASYNC_BUSY, ERR_OUTSIDE_REGION, ERR_PAIR_LAW, ERR_SNAP_READ,
+   ERR_SNAP_WRITE, ERR_SUBDIV_UNFIN, ERR_TOO_FEW_CELLS, ERR_TOO_MANY_CELLS,
+   ERR_TOO_MANY_COPIES, ERR_TOO_MANY_LAYERS, ERR_TOO_MANY_LEVELS,
+   ERR_TOO_MANY_MOLS, ERR_TOO_MANY_MOVES, ERR_TOO_MANY_NEBRS,
+   ERR_TOO_MANY_REPLICAS};
 
 char *errorMsg[] = {"", "bond snapped", "read checkpoint data",
    "write checkpoint data", "copy buffer full", "empty event pool",
-   "message buffer full", "outside region", "read snap data",
-   "write snap data", "subdivision unfinished", "too many cells",
-   "too many copied mols", "too many layers", "too many levels",
-   "too many mols", "too many moved mols", "too many neighbors",
-   "too many replicas"};
+   "message buffer full", "cells in use by neighbor helper",
+   "outside region", "unknown pair law", "read snap data",
+   "write snap data", "subdivision unfinished", "too few cells",
+   "too many cells", "too many copied mols", "too many layers",
+   "too many levels", "too many mols", "too many moved mols",
+   "too many neighbors", "too many replicas"};
 
@@ -0,0 +1,54 @@
+
+#ifndef MEM_DEFS
+
+#define MEM_DEFS
+
+#include <sys/mman.h>
+
+/* all blocks from AllocMem are aligned for SIMD loads and may be
+   released with free; blocks of at least MEM_HUGE_MIN bytes (the
+   particle arrays of large systems) are aligned to the huge page size
+   and, unless NO_HUGE_PAGES is defined, marked for transparent huge
+   pages */
+
+#define SIMD_ALIGN  64
+#define MEM_HUGE_ALIGN  (1 << 21)
+#define MEM_HUGE_MIN  (1 << 23)
+#define MEM_SCRATCH_MAX  4
+
+#define AllocScratch(a, k, n, t)                            \
+   a = (t *) GetScratch (k, (n) * sizeof (t))
+
+static inline void *MallocA (size_t size)
+{
+  void *p;
+  size_t align;
+
+  align = (size >= MEM_HUGE_MIN) ? MEM_HUGE_ALIGN : SIMD_ALIGN;
+  size = (size + align - 1) / align * align;
+  if (posix_memalign (&p, align, Max (size, align)) != 0) p = NULL;
+#ifndef NO_HUGE_PAGES
+  else if (align == MEM_HUGE_ALIGN) madvise (p, size, MADV_HUGEPAGE);
+#endif
+  return (p);
+}
+
+/* scratch buffer k is kept between calls and only grows, so that
+   buffers used for each snapshot or analysis pass are not allocated
+   afresh every time; the contents are not preserved when it grows */
+
+void *memScratch[MEM_SCRATCH_MAX];
+size_t memScratchSize[MEM_SCRATCH_MAX];
+
+static inline void *GetScratch (int k, size_t size)
+{
+  if (size > memScratchSize[k]) {
+    free (memScratch[k]);
+    memScratch[k] = MallocA (size);
+    memScratchSize[k] = size;
+  }
+  return (memScratch[k]);
+}
+
+#endif
+
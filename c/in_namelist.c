@@ -1,6 +1,7 @@
 
 #define NP_I  ((int *)  (nameList[k].vPtr) + j)
 #define NP_R  ((real *) (nameList[k].vPtr) + j)
+#define NP_S  ((char *) (nameList[k].vPtr) + j * NAME_S_LEN)
 
 int GetNameList (int argc, char **argv)
 {
@@ -33,6 +34,9 @@ int GetNameList (int argc, char **argv)
                 case N_R:
                   *NP_R = atof (token);
                   break;
+                case N_S:
+                  strncpy (NP_S, token, NAME_S_LEN - 1);
+                  break;
               }
             } else {
               nameList[k].vStatus = 2;
@@ -77,6 +81,9 @@ void PrintNameList (FILE *fp)
           case N_R:
             fprintf (fp, "%#g ", *NP_R);
             break;
+          case N_S:
+            fprintf (fp, "%s ", NP_S);
+            break;
         }
       }
     }
@@ -1,8 +1,11 @@
 
-typedef enum {N_I, N_R} VType;
+typedef enum {N_I, N_R, N_S} VType;
+
+#define NAME_S_LEN  32
 
 #define NameI(x)  {#x, &x, N_I, sizeof (x) / sizeof (int)}
 #define NameR(x)  {#x, &x, N_R, sizeof (x) / sizeof (real)}
+#define NameS(x)  {#x, x, N_S, sizeof (x) / NAME_S_LEN}
 
 typedef struct {
   char *vName;
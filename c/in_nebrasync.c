@@ -0,0 +1,95 @@
+
+#define NR(j)  (*(VecR *) ((char *) r + (j) * stride))
+
+void AllocNebrAsync (int np)
+{
+  AllocMem (nebrAsyncR, np, VecR);
+  AllocMem (nebrAsyncTabPtr, np + 1, int);
+  nebrAsyncTabMax = nebrTabMax;
+  AllocMem (nebrAsyncTab, nebrAsyncTabMax, int);
+  SET_NEBR_ASYNC_STATE (0);
+}
+
+/* nebrAsyncState is 0 when idle, 1 while the helper is building and 2
+   once its list is complete */
+
+void StartNebrAsync (VecR *r, int stride, int np, real rNebr)
+{
+  int n;
+
+  if (nebrAsyncTabMax < nebrTabMax) {
+    nebrAsyncTabMax = nebrTabMax;
+    free (nebrAsyncTab);
+    AllocMem (nebrAsyncTab, nebrAsyncTabMax, int);
+  }
+  for (n = 0; n < np; n ++) nebrAsyncR[n] = NR (n);
+  nebrAsyncNp = np;
+  nebrAsyncRange = rNebr;
+  SET_NEBR_ASYNC_STATE (1);
+  pthread_create (&nebrAsyncThread, NULL, NebrAsyncWorker, NULL);
+}
+
+void *NebrAsyncWorker (void *tr)
+{
+  SetCellStencil (nebrAsyncRange);
+  BinCells (nebrAsyncR, sizeof (VecR), nebrAsyncNp);
+  while ((nebrAsyncLen = BuildNebrRows (nebrAsyncR, sizeof (VecR), 0,
+     nebrAsyncNp, nebrAsyncRange, nebrAsyncTab, nebrAsyncTabPtr,
+     nebrAsyncTabMax)) < 0) {
+    nebrAsyncTabMax += nebrAsyncTabMax / 2 + nebrAsyncNp;
+    free (nebrAsyncTab);
+    AllocMem (nebrAsyncTab, nebrAsyncTabMax, int);
+  }
+  nebrAsyncTabPtr[nebrAsyncNp] = nebrAsyncLen;
+  SET_NEBR_ASYNC_STATE (2);
+  return (NULL);
+}
+
+/* if the helper's list is complete (or, with wait set, once it is),
+   it replaces the current list provided it was built for the range
+   rCut + shell and no two particles can since have approached by more
+   than shell; returns 1 if the list was replaced */
+
+int FinishNebrAsync (VecR *r, int stride, int np, real shell, int wait)
+{
+  VecR *rp, d;
+  real dd, dd1, dd2;
+  int *t, n, state;
+
+  state = NEBR_ASYNC_STATE ();
+  if (state == 0 || (! wait && state != 2)) return (0);
+  pthread_join (nebrAsyncThread, NULL);
+  SET_NEBR_ASYNC_STATE (0);
+  dd1 = dd2 = 0.;
+  for (n = 0; n < np; n ++) {
+    VSub (d, NR (n), nebrAsyncR[n]);
+    VWrapAll (d);
+    dd = VLenSq (d);
+    NEBR_DISP_MERGE (dd, dd1, dd2);
+  }
+  if (nebrAsyncRange < rCut + shell || sqrt (dd1) + sqrt (dd2) > shell) {
+    ++ nebrAsyncDiscard;
+    return (0);
+  }
+  t = nebrTab;
+  nebrTab = nebrAsyncTab;
+  nebrAsyncTab = t;
+  t = nebrTabPtr;
+  nebrTabPtr = nebrAsyncTabPtr;
+  nebrAsyncTabPtr = t;
+  rp = nebrRefR;
+  nebrRefR = nebrAsyncR;
+  nebrAsyncR = rp;
+  n = nebrTabMax;
+  nebrTabMax = nebrAsyncTabMax;
+  nebrAsyncTabMax = n;
+  nebrTabLen = nebrAsyncLen;
+  nebrDispSq1 = dd1;
+  nebrDispSq2 = dd2;
+  ++ nebrBuildCount;
+  ++ nebrAsyncSwap;
+  return (1);
+}
+
+#undef NR
+
@@ -0,0 +1,43 @@
+
+#ifndef NEBR_ASYNC_DEFS
+
+#define NEBR_ASYNC_DEFS
+
+/* link with -lpthread */
+
+#include <pthread.h>
+
+/* a helper thread builds the next list from a snapshot of the
+   coordinates taken once the displacements reach NEBR_ASYNC_START of
+   the shell width; the list is swapped in when ready, provided it is
+   still valid for the current coordinates, otherwise a normal build is
+   done; the shell is widened by NEBR_ASYNC_SKIN to allow for the steps
+   taken while the helper runs; meanwhile the helper owns the cell
+   arrays (cellStart, cellList, cellOf and the stencil), so the main
+   thread may only use the lists for the forces and must not bin, tune
+   the shell or reorder until the helper is joined */
+
+#define NEBR_ASYNC_SKIN  0.05
+#define NEBR_ASYNC_START  0.5
+
+#define START_NEBR_ASYNC(a, np, rNebr)                      \
+   StartNebrAsync (&(a)[0].r, sizeof ((a)[0]), np, rNebr)
+#define FINISH_NEBR_ASYNC(a, np, shell, wait)               \
+   FinishNebrAsync (&(a)[0].r, sizeof ((a)[0]), np, shell, wait)
+
+/* nebrAsyncState is shared with the helper */
+
+#define NEBR_ASYNC_STATE()                                  \
+   __atomic_load_n (&nebrAsyncState, __ATOMIC_ACQUIRE)
+#define SET_NEBR_ASYNC_STATE(s)                             \
+   __atomic_store_n (&nebrAsyncState, s, __ATOMIC_RELEASE)
+
+pthread_t nebrAsyncThread;
+VecR *nebrAsyncR;
+real nebrAsyncRange;
+int *nebrAsyncTab, *nebrAsyncTabPtr, nebrAsync, nebrAsyncDiscard,
+   nebrAsyncLen, nebrAsyncNp, nebrAsyncState, nebrAsyncSwap,
+   nebrAsyncTabMax;
+
+#endif
+
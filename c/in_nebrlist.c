@@ -0,0 +1,340 @@
+
+/* neighbor list in CSR form: the partners of particle j1 (each
+   pair is listed once, or in the rows of both particles if nebrFull is
+   set) are nebrTab[nebrTabPtr[j1] ... nebrTabPtr[j1 + 1] - 1], or the
+   packed entries in nebrPackTab if nebrPack is set; nebrTab is enlarged
+   whenever it proves too small; the cells must already be binned (and
+   for BuildNebrRows the stencil set by SetCellStencil); programs can
+   restrict the pairs considered (NEBR_PAIR_OK), alter the range test
+   (NEBR_PAIR_IN) or replace the periodic cell wrapping
+   (NEBR_CELL_WRAP) */
+
+#ifndef NEBR_PAIR_OK
+#define NEBR_PAIR_OK(j1, j2)  1
+#endif
+#ifndef NEBR_PAIR_IN
+#define NEBR_PAIR_IN(j1, j2, rr)  ((rr) < Sqr (rNebr))
+#endif
+#ifndef NEBR_CELL_WRAP
+#define NEBR_CELL_WRAP  VCellWrapAll ()
+#endif
+
+#define NR(j)  (*(VecR *) ((char *) r + (j) * stride))
+
+void BuildNebrTab (VecR *r, int stride, int np, real rNebr)
+{
+  SetCellStencil (rNebr);
+  if (nebrPack) PackNebrRows (r, stride, np, rNebr);
+  else {
+    while ((nebrTabLen = BuildNebrRows (r, stride, 0, np, rNebr, nebrTab,
+       nebrTabPtr, nebrTabMax)) < 0)
+       ResizeNebrTab (nebrTabMax + nebrTabMax / 2 + np);
+    nebrTabPtr[np] = nebrTabLen;
+  }
+}
+
+/* the list storage (and the cluster list derived from it) is
+   reallocated to hold nt entries */
+
+void ResizeNebrTab (int nt)
+{
+  nebrTabMax = nt;
+  free (nebrTab);
+  AllocMem (nebrTab, nebrTabMax, int);
+  if (nebrClustSize > 0) {
+    free (nebrClustTab);
+    free (nebrClustTmp);
+    AllocMem (nebrClustTab, nebrTabMax, int);
+    AllocMem (nebrClustTmp, nebrTabMax, int);
+  }
+}
+
+/* the rows are built NEBR_PACK_ROWS at a time in a scratch buffer and
+   then packed, so that the full list is never stored uncompressed; the
+   row pointers in nebrTabPtr then refer to nebrPackTab, and both it and
+   the buffer grow as needed */
+
+void PackNebrRows (VecR *r, int stride, int np, real rNebr)
+{
+  short *t;
+  int *buf, j1, jBeg, jEnd, k, k2, n, nTab;
+
+  nebrTabLen = 0;
+  nebrPackLen = 0;
+  nebrPackBufMax = Max (nebrPackBufMax, NEBR_PACK_ROWS);
+  for (jBeg = 0; jBeg < np; jBeg += NEBR_PACK_ROWS) {
+    jEnd = Min (jBeg + NEBR_PACK_ROWS, np);
+    while (1) {
+      AllocScratch (buf, NEBR_PACK_BUF, nebrPackBufMax, int);
+      nTab = BuildNebrRows (r, stride, jBeg, jEnd, rNebr, buf, nebrTabPtr,
+         nebrPackBufMax);
+      if (nTab >= 0) break;
+      nebrPackBufMax *= 2;
+    }
+    nebrTabLen += nTab;
+    k = 0;
+    for (j1 = jBeg; j1 < jEnd; j1 ++) {
+      k2 = (j1 + 1 < jEnd) ? nebrTabPtr[j1 + 1] : nTab;
+      nebrTabPtr[j1] = nebrPackLen;
+      if (nebrPackLen + 2 * (k2 - k) + 2 > nebrPackMax) {
+        nebrPackMax = Max (nebrPackLen + 2 * (k2 - k) + 2,
+           nebrPackMax + nebrPackMax / 2);
+        t = nebrPackTab;
+        AllocMem (nebrPackTab, nebrPackMax + NEBR_PACK_PAD, short);
+        if (nebrPackLen > 0)
+           memcpy (nebrPackTab, t, nebrPackLen * sizeof (short));
+        free (t);
+      }
+      for (n = k; n < k2; n ++) {
+        if (abs (buf[n] - j1) >= - NEBR_PACK_ESC) break;
+      }
+      if (n == k2) {
+        for (; k < k2; k ++) nebrPackTab[nebrPackLen ++] = buf[k] - j1;
+      } else {
+        nebrPackTab[nebrPackLen] = NEBR_PACK_ESC;
+        nebrPackLen = NEBR_PACK_WIDE (nebrPackLen);
+        memcpy (nebrPackTab + nebrPackLen, buf + k, (k2 - k) * sizeof (int));
+        nebrPackLen += 2 * (k2 - k);
+        k = k2;
+      }
+    }
+  }
+  nebrTabPtr[np] = nebrPackLen;
+}
+
+/* rows jBeg ... jEnd - 1 of the list, stored in tab (of size tabMax)
+   with the row pointers, relative to tab, in tabPtr; returns the number
+   of entries, or -1 if tab is too small; disjoint row ranges can be
+   built concurrently; the partners are examined in ranges of cell
+   slots, one per cell or, if the stencil does not wrap, one per
+   stencil row, a slot belonging to the cell of j1 if it lies between
+   kOwn1 and kOwn2 */
+
+int BuildNebrRows (VecR *r, int stride, int jBeg, int jEnd, real rNebr,
+   int *tab, int *tabPtr, int tabMax)
+{
+  VecR dr, ri, shift, shiftList[2 * CELL_OFF_MAX];
+  VecI m1v, m2v;
+  int j1, j2, k, kBeg[2 * CELL_OFF_MAX], kEnd[2 * CELL_OFF_MAX], kOwn1,
+     kOwn2, kk, m1, m1Last, m2, nOffset, nTab, offset;
+
+  nTab = 0;
+  m1Last = -1;
+  nOffset = 0;
+  kOwn1 = kOwn2 = 0;
+  for (j1 = jBeg; j1 < jEnd; j1 ++) {
+    tabPtr[j1] = nTab;
+    ri = NR (j1);
+    m1 = cellOf[j1];
+    if (m1 != m1Last) {
+      VCellVec (m1v, m1);
+      kOwn1 = cellStart[m1];
+      kOwn2 = cellStart[m1 + 1];
+      nOffset = 0;
+      if (CELL_INTERIOR (m1v)) {
+        for (k = 0; k < (nebrFull ? 2 * nCellOffRow : nCellOffRow); k ++) {
+          if (k < nCellOffRow) {
+            m2 = m1 + cellOffRow[k];
+            kk = cellOffRowLen[k];
+          } else {
+            kk = k - nCellOffRow;
+            m2 = m1 - cellOffRow[kk] - cellOffRowLen[kk] + 1;
+            kk = cellOffRowLen[kk] - (kk == 0);
+          }
+          kBeg[nOffset] = cellStart[m2];
+          kEnd[nOffset] = cellStart[m2 + kk];
+          VZero (shiftList[nOffset]);
+          ++ nOffset;
+        }
+      } else {
+        for (offset = 0; offset < (nebrFull ? 2 * nCellOff - 1 :
+           nCellOff); offset ++) {
+          if (offset < nCellOff) VAdd (m2v, m1v, cellOff[offset]);
+          else VSub (m2v, m1v, cellOff[offset - nCellOff + 1]);
+          VZero (shift);
+          NEBR_CELL_WRAP;
+          m2 = VLinear (m2v, cells);
+          kBeg[nOffset] = cellStart[m2];
+          kEnd[nOffset] = cellStart[m2 + 1];
+          shiftList[nOffset] = shift;
+          ++ nOffset;
+        }
+      }
+      m1Last = m1;
+    }
+    for (k = 0; k < nOffset; k ++) {
+      for (kk = kBeg[k]; kk < kEnd[k]; kk ++) {
+        j2 = cellList[kk];
+        if ((kk < kOwn1 || kk >= kOwn2 || j2 < j1 || (nebrFull && j2 > j1)) &&
+           NEBR_PAIR_OK (j1, j2)) {
+          VSub (dr, ri, NR (j2));
+          VVSub (dr, shiftList[k]);
+          if (NEBR_PAIR_IN (j1, j2, VLenSq (dr))) {
+            if (nTab >= tabMax) return (-1);
+            tab[nTab] = j2;
+            ++ nTab;
+          }
+        }
+      }
+    }
+  }
+  return (nTab);
+}
+
+/* positions at the time of the build, from which displacements are
+   measured (nebrRefR must be allocated for np particles) */
+
+void SaveNebrRef (VecR *r, int stride, int np)
+{
+  int n;
+
+  for (n = 0; n < np; n ++) nebrRefR[n] = NR (n);
+  ++ nebrBuildCount;
+}
+
+void PrintNebrStats (FILE *fp, int nStep)
+{
+  fprintf (fp, "neighbor list builds %d, mean interval %.2f steps\n",
+     nebrBuildCount, (real) nStep / Max (nebrBuildCount, 1));
+  if (nebrPack) fprintf (fp, "packed list %d entries, %.2f bytes each\n",
+     nebrTabLen, 2. * nebrPackLen / Max (nebrTabLen, 1));
+}
+
+#undef NR
+
+/* cluster-pair list derived from the particle list: cluster c holds
+   particles c * nebrClustSize onwards (so the particles should be in
+   space-filling curve order), and cluster c interacts with clusters
+   nebrClustTab[nebrClustPtr[c] ... nebrClustPtr[c + 1] - 1], each
+   not less than c; every pair of particles in the listed clusters is
+   examined, so the list covers all the pairs in nebrTab */
+
+void AllocNebrClusters (int np)
+{
+  int nc;
+
+  nc = (np + nebrClustSize - 1) / nebrClustSize;
+  AllocMem (nebrClustPtr, nc + 1, int);
+  AllocMem (nebrClustMark, nc, int);
+  AllocMem (nebrClustTab, nebrTabMax, int);
+  AllocMem (nebrClustTmp, nebrTabMax, int);
+}
+
+void BuildNebrClusters (int np)
+{
+  int c, c1, c2, j1, k, n;
+
+  nNebrClust = (np + nebrClustSize - 1) / nebrClustSize;
+  for (c = 0; c <= nNebrClust; c ++) nebrClustPtr[c] = 0;
+  for (j1 = 0; j1 < np; j1 ++) {
+    c1 = j1 / nebrClustSize;
+    for (n = nebrTabPtr[j1]; n < nebrTabPtr[j1 + 1]; n ++) {
+      c2 = nebrTab[n] / nebrClustSize;
+      ++ nebrClustPtr[Min (c1, c2) + 1];
+    }
+  }
+  for (c = 0; c < nNebrClust; c ++) nebrClustPtr[c + 1] += nebrClustPtr[c];
+  for (j1 = 0; j1 < np; j1 ++) {
+    c1 = j1 / nebrClustSize;
+    for (n = nebrTabPtr[j1]; n < nebrTabPtr[j1 + 1]; n ++) {
+      c2 = nebrTab[n] / nebrClustSize;
+      nebrClustTmp[nebrClustPtr[Min (c1, c2)] ++] = Max (c1, c2);
+    }
+  }
+  for (c = 0; c < nNebrClust; c ++) nebrClustMark[c] = -1;
+  nebrClustLen = 0;
+  k = 0;
+  for (c = 0; c < nNebrClust; c ++) {
+    n = k;
+    k = nebrClustPtr[c];
+    nebrClustPtr[c] = nebrClustLen;
+    for (; n < k; n ++) {
+      c2 = nebrClustTmp[n];
+      if (nebrClustMark[c2] != c) {
+        nebrClustMark[c2] = c;
+        nebrClustTab[nebrClustLen] = c2;
+        ++ nebrClustLen;
+      }
+    }
+  }
+  nebrClustPtr[nNebrClust] = nebrClustLen;
+}
+
+/* the shell width and cell subdivision are chosen by running
+   stepTuneShell steps with each pair of candidates (shells from
+   NEBR_TUNE_SHELLS, cellDiv from 1 to NEBR_TUNE_DIV) that leaves enough
+   cells across the region (NEBR_TUNE_PASS passes through the list,
+   keeping the shortest time, to reduce the effect of timing noise and
+   of the drift during equilibration), and then keeping the pair with
+   the lowest time per step; the cells are enlarged when needed (the
+   list storage grows by itself) and the list is rebuilt for each trial;
+   stepTuneShell is reset once the choice is made; nebrTuneSkin, which a
+   program sets when the runs will use a wider shell than the trials
+   (e.g., for background builds, which are not made during the trials),
+   is added to the chosen shell; called at the end of each step */
+
+void TuneNebrShell ()
+{
+  struct timeval tv;
+  VecI cc;
+  real sList[] = NEBR_TUNE_SHELLS, t, tBest, w;
+  int d, k, kBest, nc, ns, ok;
+
+  ns = sizeof (sList) / sizeof (sList[0]) * NEBR_TUNE_DIV;
+  if (stepTuneShell <= 0 || nebrTuneIdx > NEBR_TUNE_PASS * ns ||
+     stepCount % stepTuneShell != 0) return;
+  gettimeofday (&tv, NULL);
+  if (nebrTuneIdx > 0) {
+    t = ((tv.tv_sec - nebrTuneTv.tv_sec) + 1e-6 * (tv.tv_usec -
+       nebrTuneTv.tv_usec)) / stepTuneShell;
+    k = (nebrTuneIdx - 1) % ns;
+    if (nebrTuneTime[k] == 0. || t < nebrTuneTime[k]) nebrTuneTime[k] = t;
+  }
+  do {
+    if (nebrTuneIdx < NEBR_TUNE_PASS * ns) {
+      k = nebrTuneIdx % ns;
+      w = sList[k % (ns / NEBR_TUNE_DIV)];
+      d = 1 + k / (ns / NEBR_TUNE_DIV);
+    } else {
+      kBest = -1;
+      tBest = 0.;
+      for (k = 0; k < ns; k ++) {
+        if (nebrTuneTime[k] > 0.) {
+          printf ("shell %.2f, cellDiv %d: %.4f ms/step\n",
+             sList[k % (ns / NEBR_TUNE_DIV)], 1 + k / (ns / NEBR_TUNE_DIV),
+             1e3 * nebrTuneTime[k]);
+          if (kBest < 0 || nebrTuneTime[k] < tBest) {
+            kBest = k;
+            tBest = nebrTuneTime[k];
+          }
+        }
+      }
+      w = rNebrShell;
+      d = cellDiv;
+      if (kBest >= 0) {
+        w = sList[kBest % (ns / NEBR_TUNE_DIV)];
+        d = 1 + kBest / (ns / NEBR_TUNE_DIV);
+      }
+      w += nebrTuneSkin;
+      printf ("rNebrShell set to %.2f, cellDiv to %d\n", w, d);
+      stepTuneShell = 0;
+    }
+    VSCopy (cc, d / (rCut + w), region);
+    ok = 1;
+    for (k = 0; k < NDIM; k ++) {
+      if (VComp (cc, k) < 2 * d + 1) ok = 0;
+    }
+    ++ nebrTuneIdx;
+  } while (! ok && nebrTuneIdx <= NEBR_TUNE_PASS * ns);
+  if (! ok) return;
+  nc = VProd (cells);
+  rNebrShell = w;
+  cellDiv = d;
+  cells = cc;
+  if (VProd (cells) > nc) {
+    free (cellStart);
+    AllocMem (cellStart, VProd (cells) + 1, int);
+  }
+  nebrNow = 1;
+  gettimeofday (&nebrTuneTv, NULL);
+}
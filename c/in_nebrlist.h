@@ -0,0 +1,63 @@
+
+#ifndef NEBR_LIST_DEFS
+
+#define NEBR_LIST_DEFS
+
+#define BUILD_NEBR_TAB(a, np, rNebr)                        \
+   BuildNebrTab (&(a)[0].r, sizeof ((a)[0]), np, rNebr)
+#define SAVE_NEBR_REF(a, np)                                \
+   SaveNebrRef (&(a)[0].r, sizeof ((a)[0]), np)
+
+/* the list remains valid while no two particles can have approached
+   by more than the shell width, which is assured if the sum of the two
+   largest displacements since the last build does not exceed it; the
+   displacements are tracked during the coordinate update */
+
+#define NEBR_DISP_ZERO  nebrDispSq1 = nebrDispSq2 = 0.
+#define NEBR_DISP_MERGE(dd, dd1, dd2)                       \
+   {if ((dd) > dd2) {                                       \
+     if ((dd) > dd1) {                                      \
+       dd2 = dd1;                                           \
+       dd1 = dd;                                            \
+     } else dd2 = dd;                                       \
+   }}
+#define NEBR_DISP_TRACK(p, n)                               \
+   {VecR d_;                                                \
+   real dd_;                                                \
+   VSub (d_, p, nebrRefR[n]);                               \
+   VWrapAll (d_);                                           \
+   dd_ = VLenSq (d_);                                       \
+   NEBR_DISP_MERGE (dd_, nebrDispSq1, nebrDispSq2);         \
+   }
+#define NEBR_DISP_OVER(shell)                               \
+   (sqrt (nebrDispSq1) + sqrt (nebrDispSq2) > (shell))
+
+/* a packed row holds, for each partner j2 of j1, the 16-bit offset
+   j2 - j1 or, if any partner is too far away in index (which is rare
+   once the particles are in space-filling curve order), NEBR_PACK_ESC
+   followed by the full indices, which start at the even offset (from
+   the start of the table, itself aligned) given by NEBR_PACK_WIDE; the
+   table is padded so that a SIMD load of offsets may run past the last
+   row */
+
+#define NEBR_PACK_BUF  1
+#define NEBR_PACK_ESC  (-32768)
+#define NEBR_PACK_PAD  16
+#define NEBR_PACK_ROWS  256
+#define NEBR_PACK_WIDE(k)  ((k) + 1 + ((k) + 1) % 2)
+
+#define NEBR_TUNE_DIV  2
+#define NEBR_TUNE_PASS  2
+#define NEBR_TUNE_SHELLS  {0.1, 0.15, 0.2, 0.3, 0.4, 0.5, 0.6, 0.8}
+
+VecR *nebrRefR;
+struct timeval nebrTuneTv;
+real nebrDispSq1, nebrDispSq2, nebrTuneSkin, nebrTuneTime[32];
+int nebrTuneIdx, stepTuneShell;
+short *nebrPackTab;
+int *nebrClustMark, *nebrClustPtr, *nebrClustTab, *nebrClustTmp,
+   nebrClustLen, nebrClustSize, nebrFull, nNebrClust, nebrBuildCount;
+int nebrPack, nebrPackBufMax, nebrPackLen, nebrPackMax;
+
+#endif
+
@@ -0,0 +1,785 @@
+
+void SetPairParams (real rc, real uShift)
+{
+  pairRrCut = Sqr (rc);
+  pairUShift = uShift;
+}
+
+/* pair law (see pairLawName) for separation squared rr, giving the
+   energy u and fc, the force divided by the separation */
+
+void EvalPairLaw (real rr, real *u, real *fc)
+{
+  real aCon = 7.0496, bCon = 0.60222, er, rc, ri, ri3, rm, rrd, rri,
+     rri3;
+
+  *u = *fc = 0.;
+  if (pairLawId == PAIR_SW) {
+    if (rr >= pairRrCut) return;
+    rm = sqrt (rr);
+    rc = sqrt (pairRrCut);
+    er = exp (1. / (rm - rc));
+    ri = 1. / rm;
+    ri3 = Cube (ri);
+    *fc = aCon * (4. * bCon * Sqr (ri3) + (bCon * ri3 * ri - 1.) * ri /
+       Sqr (rm - rc)) * er;
+    *u = aCon * (bCon * ri3 * ri - 1.) * er;
+  } else if (pairLawId == PAIR_LJ_SPLINE && rr >= Sqr (pairSwitch)) {
+    rrd = pairRrCut - rr;
+    *fc = (4. * pairSplineA2 + 6. * pairSplineA3 * rrd) * rrd;
+    *u = (pairSplineA2 + pairSplineA3 * rrd) * Sqr (rrd);
+  } else {
+    rri = 1. / rr;
+    rri3 = Cube (rri);
+    *fc = 48. * rri3 * (rri3 - 0.5) * rri;
+    *u = 4. * rri3 * (rri3 - 1.);
+  }
+}
+
+/* the pair law is chosen by name (LJ if the name is empty) and its
+   cutoff is returned; the energy is shifted to vanish there; the forms
+   other than LJ are those of the Stillinger-Weber pair term (pr_12_1)
+   and the LJ spline of the EAM model (pr_12_2) */
+
+real SetPairLaw (char *name)
+{
+  real bb, fc, p, pd, rc, rr, rr3, u;
+  int k;
+
+  pairLawId = name[0] ? -1 : PAIR_LJ;
+  for (k = 0; k < PAIR_LAW_NUM; k ++) {
+    if (strcmp (name, pairLawName[k]) == 0) pairLawId = k;
+  }
+  if (pairLawId < 0) ErrExit (ERR_PAIR_LAW);
+  rc = pow (2., 1./6.);
+  if (pairLawId == PAIR_LJ_CUT) rc = 2.5;
+  else if (pairLawId == PAIR_LJ_SPLINE) {
+    pairSwitch = pow (26. / 7., 1. / 6.);
+    rr = Sqr (pairSwitch);
+    rr3 = Cube (rr);
+    p = 4. * (1. / rr3 - 1.) / rr3;
+    pd = - 48. * (1. / rr3 - 0.5) / (pairSwitch * rr3);
+    bb = 4. * (1. - sqrt (1. + 3. * p / (2. * pairSwitch * pd)));
+    pairSplineA2 = (6. * p + bb * pairSwitch * pd) / (2. * Sqr (bb * rr));
+    pairSplineA3 = - (4. * p + bb * pairSwitch * pd) /
+       (2. * Sqr (bb * rr) * bb * rr);
+    rc = pairSwitch * sqrt (bb + 1.);
+  } else if (pairLawId == PAIR_SW) rc = 1.8;
+  SetPairParams (rc, 0.);
+  EvalPairLaw (Sqr (rc), &u, &fc);
+  SetPairParams (rc, - u);
+  return (rc);
+}
+
+/* the coefficients of the clamped cubic spline through y[0] ... y[n]
+   (spacing h, end slopes d0 and d1) are stored in c, four per
+   interval, as a polynomial in the fractional position t */
+
+void PairTabSpline (real *y, real d0, real d1, int n, real h, real *c)
+{
+  real b, *cp, *mm, r;
+  int i;
+
+  AllocMem (cp, n + 1, real);
+  AllocMem (mm, n + 1, real);
+  for (i = 0; i <= n; i ++) {
+    if (i == 0) r = 6. * ((y[1] - y[0]) / h - d0) / h;
+    else if (i == n) r = 6. * (d1 - (y[n] - y[n - 1]) / h) / h;
+    else r = 6. * (y[i + 1] - 2. * y[i] + y[i - 1]) / Sqr (h);
+    b = (i == 0 || i == n) ? 2. : 4.;
+    if (i > 0) {
+      b -= cp[i - 1];
+      r -= mm[i - 1];
+    }
+    cp[i] = 1. / b;
+    mm[i] = r / b;
+  }
+  for (i = n - 1; i >= 0; i --) mm[i] -= cp[i] * mm[i + 1];
+  for (i = 0; i < n; i ++) {
+    c[i * PAIR_TAB_STRIDE] = y[i];
+    c[i * PAIR_TAB_STRIDE + 1] = y[i + 1] - y[i] -
+       Sqr (h) * (2. * mm[i] + mm[i + 1]) / 6.;
+    c[i * PAIR_TAB_STRIDE + 2] = 0.5 * Sqr (h) * mm[i];
+    c[i * PAIR_TAB_STRIDE + 3] = Sqr (h) * (mm[i + 1] - mm[i]) / 6.;
+  }
+  c[n * PAIR_TAB_STRIDE] = y[n];
+  c[n * PAIR_TAB_STRIDE + 1] = c[n * PAIR_TAB_STRIDE + 2] =
+     c[n * PAIR_TAB_STRIDE + 3] = 0.;
+  free (cp);
+  free (mm);
+}
+
+/* the pair law is tabulated for the kernels using n intervals uniform
+   in r^2 from PAIR_TAB_RMIN to the cutoff, each holding the spline
+   coefficients of the energy and of fc; the end slopes of fc are
+   estimated by one-sided differences; the analytic kernel is used if n
+   is zero (only for the LJ laws) */
+
+void BuildPairTab (int n)
+{
+  real d0, d1, e, *f, f1, f2, h, u, *uv;
+  int i;
+
+  if (n == 0 && pairLawId != PAIR_LJ && pairLawId != PAIR_LJ_CUT)
+     n = PAIR_TAB_LEN;
+  pairTabLen = n;
+  if (n == 0) return;
+  pairRrTabMin = Sqr (PAIR_TAB_RMIN);
+  h = (pairRrCut - pairRrTabMin) / n;
+  pairTabScale = 1. / h;
+  AllocMem (pairTab, (n + 1) * PAIR_TAB_STRIDE, real);
+  AllocMem (uv, n + 1, real);
+  AllocMem (f, n + 1, real);
+  for (i = 0; i <= n; i ++)
+     EvalPairLaw (pairRrTabMin + i * h, &uv[i], &f[i]);
+  PairTabSpline (uv, -0.5 * f[0], -0.5 * f[n], n, h, pairTab);
+  e = 1e-3 * h;
+  EvalPairLaw (pairRrTabMin + e, &u, &f1);
+  EvalPairLaw (pairRrTabMin + 2. * e, &u, &f2);
+  d0 = (4. * f1 - f2 - 3. * f[0]) / (2. * e);
+  EvalPairLaw (pairRrCut - e, &u, &f1);
+  EvalPairLaw (pairRrCut - 2. * e, &u, &f2);
+  d1 = (3. * f[n] - 4. * f1 + f2) / (2. * e);
+  PairTabSpline (f, d0, d1, n, h, pairTab + 4);
+  free (uv);
+  free (f);
+}
+
+/* spline interpolation of the tabulated energy u (omitted if u is
+   NULL) and fc for the pairs in mask m; separations below the table
+   use its first interval */
+
+static inline void PairTabEval (SVReal rr, SVMask m, SVReal *fc,
+   SVReal *u)
+{
+  SVReal c[PAIR_TAB_STRIDE], t, x;
+  SVIdx vi;
+  int k;
+
+  x = SVMul (SVSub (SVMax (rr, SVSet1 (pairRrTabMin)),
+     SVSet1 (pairRrTabMin)), SVSet1 (pairTabScale));
+  t = SVFloor (x);
+  vi = SVToIdx (SVMul (t, SVSet1 ((real) PAIR_TAB_STRIDE)));
+  t = SVSub (x, t);
+  for (k = u ? 0 : 4; k < PAIR_TAB_STRIDE; k ++)
+     c[k] = SVGatherIdxM (pairTab + k, vi, m);
+  if (u) *u = SVAdd (SVMul (SVAdd (SVMul (SVAdd (SVMul (c[3], t),
+     c[2]), t), c[1]), t), c[0]);
+  *fc = SVAdd (SVMul (SVAdd (SVMul (SVAdd (SVMul (c[7], t), c[6]), t),
+     c[5]), t), c[4]);
+}
+
+/* the pair law used by the kernels, tabulated or (if tab is zero) the
+   analytic LJ form, with the energy only if u is not NULL; tab and u
+   are constant in each instance of a kernel (see PAIR_KERNEL), so the
+   choices cost nothing inside the loops */
+
+static inline void PairLawV (SVReal rr, SVMask m, SVReal *fc, SVReal *u,
+   int tab)
+{
+  SVReal one, rri, rri3;
+
+  if (tab) PairTabEval (rr, m, fc, u);
+  else {
+    one = SVSet1 (1.);
+    rri = SVDiv (one, rr);
+    rri3 = SVMul (SVMul (rri, rri), rri);
+    *fc = SVMul (SVMul (SVSet1 (48.), rri3), SVMul (SVSub (rri3,
+       SVSet1 (0.5)), rri));
+    if (u) *u = SVMul (SVMul (SVSet1 (4.), rri3), SVSub (rri3, one));
+  }
+}
+
+/* the tabulated law is compared with the analytic form at
+   PAIR_TAB_CHECK points in each interval; the largest errors of the
+   energy and fc, relative to the analytic value (or unity, if that is
+   smaller), are reported */
+
+void PrintPairTab (FILE *fp)
+{
+  SVReal fcv, uv;
+  real eFc, eU, fc, rr, u;
+  int k;
+
+  if (pairTabLen == 0) return;
+  eFc = eU = 0.;
+  for (k = 0; k < pairTabLen * PAIR_TAB_CHECK; k ++) {
+    rr = pairRrTabMin + (k + 0.5) * (pairRrCut - pairRrTabMin) /
+       (pairTabLen * PAIR_TAB_CHECK);
+    EvalPairLaw (rr, &u, &fc);
+    PairTabEval (SVSet1 (rr), SVMaskN (1), &fcv, &uv);
+    eU = Max (eU, fabs (SVSum (uv) - u) / Max (fabs (u), 1.));
+    eFc = Max (eFc, fabs (SVSum (fcv) - fc) / Max (fabs (fc), 1.));
+  }
+  fprintf (fp, "pair law %s tabulated: %d intervals, r %.3f - %.3f\n",
+     pairLawName[pairLawId], pairTabLen, PAIR_TAB_RMIN, sqrt (pairRrCut));
+  fprintf (fp, "max relative error: energy %.2e, force %.2e\n", eU, eFc);
+}
+
+/* the working copy is held in the order given by order (e.g., cellList
+   for cell order), or in the original order if this is NULL */
+
+void GatherPairCoords (int *order)
+{
+  int n;
+
+  DO_MOL {
+    VSPut (rS, n, mol[order ? order[n] : n].r);
+    VSZero (raS, n);
+  }
+  for (n = 0; n < PAIR_THREAD_MAX; n ++)
+     pairUSumV[n] = pairVirSumV[n] = SVZero ();
+}
+
+void ScatterPairAccels (int *order)
+{
+  int n;
+
+  DO_MOL VSGet (mol[order ? order[n] : n].ra, raS, n);
+  pairUSum = 0.;
+  pairVirSum = 0.;
+  for (n = 0; n < PAIR_THREAD_MAX; n ++) {
+    pairUSum += SVSum (pairUSumV[n]);
+    pairVirSum += SVSum (pairVirSumV[n]);
+  }
+}
+
+/* storage for the single precision kernel (PairCellF), for np
+   particles and nt threads */
+
+void AllocPairFloat (int np, int nt)
+{
+  int ip;
+
+  AllocMemSF (rF, np);
+  for (ip = 0; ip < Max (nt, 1); ip ++) {
+    AllocMemSF (pairBufF[ip], np);
+    AllocMemS (pairBufA[ip], np);
+  }
+}
+
+/* interactions of j1 with nj partners; partner coordinates are
+   loaded from pS starting at jBeg (already shifted if needed) or, if pS
+   is NULL, gathered from rS using jList, or using the 16-bit offsets
+   from j1 in dList; reaction forces are scattered to raS using the
+   same indices or, if both lists are NULL, stored starting at jBeg;
+   the minimum image convention is applied if wrap is set; if energy
+   is set the energy and virial are accumulated in the sums belonging
+   to thread ip */
+
+PAIR_KERNEL void PairRowK (int ip, int j1, VecRS *pS, int *jList,
+   short *dList, int jBeg, int nj, int wrap, int tab, int energy)
+{
+  SVReal dx, dy, fc, fcx, fcy, fxi, fyi, lx, ly, lxi, lyi, rr, rrCut, u,
+     uS, uShift, vS, xi, xj, yi, yj;
+#if NDIM == 3
+  SVReal dz, fcz, fzi, lz, lzi, zi, zj;
+#endif
+  SVIdx vi;
+  SVMask m;
+  int *jp, k, l, nv;
+
+  xi = SVSet1 (rS.x[j1]);
+  yi = SVSet1 (rS.y[j1]);
+  lx = SVSet1 (region.x);
+  ly = SVSet1 (region.y);
+  lxi = SVSet1 (1. / region.x);
+  lyi = SVSet1 (1. / region.y);
+  fxi = fyi = SVZero ();
+#if NDIM == 3
+  zi = SVSet1 (rS.z[j1]);
+  lz = SVSet1 (region.z);
+  lzi = SVSet1 (1. / region.z);
+  fzi = SVZero ();
+#endif
+  rrCut = SVSet1 (pairRrCut);
+  uShift = SVSet1 (pairUShift);
+  uS = pairUSumV[ip];
+  vS = pairVirSumV[ip];
+  jp = NULL;
+  for (k = 0; k < nj; k += SIMD_LEN) {
+    nv = Min (SIMD_LEN, nj - k);
+    m = SVMaskN (nv);
+    if (jList) jp = jList + k;
+    if (pS) {
+      l = jBeg + k;
+      xj = SVLoadM (pS->x + l, m);
+      yj = SVLoadM (pS->y + l, m);
+#if NDIM == 3
+      zj = SVLoadM (pS->z + l, m);
+#endif
+    } else if (dList) {
+      vi = SVLoadIdxD (dList + k, j1);
+      xj = SVGatherIdxM (rS.x, vi, m);
+      yj = SVGatherIdxM (rS.y, vi, m);
+#if NDIM == 3
+      zj = SVGatherIdxM (rS.z, vi, m);
+#endif
+    } else {
+      xj = SVGatherM (rS.x, jp, m);
+      yj = SVGatherM (rS.y, jp, m);
+#if NDIM == 3
+      zj = SVGatherM (rS.z, jp, m);
+#endif
+    }
+    dx = SVSub (xi, xj);
+    dy = SVSub (yi, yj);
+    if (wrap) {
+      dx = SVSub (dx, SVMul (lx, SVRint (SVMul (dx, lxi))));
+      dy = SVSub (dy, SVMul (ly, SVRint (SVMul (dy, lyi))));
+    }
+    rr = SVAdd (SVMul (dx, dx), SVMul (dy, dy));
+#if NDIM == 3
+    dz = SVSub (zi, zj);
+    if (wrap) dz = SVSub (dz, SVMul (lz, SVRint (SVMul (dz, lzi))));
+    rr = SVAdd (rr, SVMul (dz, dz));
+#endif
+    m = SVMaskAnd (m, SVCmpLt (rr, rrCut));
+    if (! SVMaskAny (m)) continue;
+    PairLawV (rr, m, &fc, energy ? &u : NULL, tab);
+    fc = SVSelect (m, fc);
+    if (energy) {
+      uS = SVAdd (uS, SVSelect (m, SVAdd (u, uShift)));
+      vS = SVAdd (vS, SVMul (fc, rr));
+    }
+    fcx = SVMul (fc, dx);
+    fcy = SVMul (fc, dy);
+    fxi = SVAdd (fxi, fcx);
+    fyi = SVAdd (fyi, fcy);
+#if NDIM == 3
+    fcz = SVMul (fc, dz);
+    fzi = SVAdd (fzi, fcz);
+#endif
+    if (dList) {
+      SVScatterSubIdxM (raS.x, vi, fcx, m);
+      SVScatterSubIdxM (raS.y, vi, fcy, m);
+#if NDIM == 3
+      SVScatterSubIdxM (raS.z, vi, fcz, m);
+#endif
+    } else if (jList) {
+      SVScatterSubM (raS.x, jp, fcx, m);
+      SVScatterSubM (raS.y, jp, fcy, m);
+#if NDIM == 3
+      SVScatterSubM (raS.z, jp, fcz, m);
+#endif
+    } else {
+      m = SVMaskN (nv);
+      l = jBeg + k;
+      SVStoreM (raS.x + l, SVSub (SVLoadM (raS.x + l, m), fcx), m);
+      SVStoreM (raS.y + l, SVSub (SVLoadM (raS.y + l, m), fcy), m);
+#if NDIM == 3
+      SVStoreM (raS.z + l, SVSub (SVLoadM (raS.z + l, m), fcz), m);
+#endif
+    }
+  }
+  raS.x[j1] += SVSum (fxi);
+  raS.y[j1] += SVSum (fyi);
+#if NDIM == 3
+  raS.z[j1] += SVSum (fzi);
+#endif
+  pairUSumV[ip] = uS;
+  pairVirSumV[ip] = vS;
+}
+
+/* the kernel instances for the combinations of the minimum image,
+   table and energy options; the energy and virial are omitted on steps
+   for which the driver sets pairForceOnly */
+
+void PairRow (int ip, int j1, VecRS *pS, int *jList, int jBeg, int nj,
+   int wrap)
+{
+  switch ((pairTabLen > 0) * 4 + (wrap != 0) * 2 + ! pairForceOnly) {
+    case 0: PairRowK (ip, j1, pS, jList, NULL, jBeg, nj, 0, 0, 0); break;
+    case 1: PairRowK (ip, j1, pS, jList, NULL, jBeg, nj, 0, 0, 1); break;
+    case 2: PairRowK (ip, j1, pS, jList, NULL, jBeg, nj, 1, 0, 0); break;
+    case 3: PairRowK (ip, j1, pS, jList, NULL, jBeg, nj, 1, 0, 1); break;
+    case 4: PairRowK (ip, j1, pS, jList, NULL, jBeg, nj, 0, 1, 0); break;
+    case 5: PairRowK (ip, j1, pS, jList, NULL, jBeg, nj, 0, 1, 1); break;
+    case 6: PairRowK (ip, j1, pS, jList, NULL, jBeg, nj, 1, 1, 0); break;
+    case 7: PairRowK (ip, j1, pS, jList, NULL, jBeg, nj, 1, 1, 1); break;
+  }
+}
+
+#ifdef NEBR_LIST_DEFS
+
+/* interactions of j1 with the partners in packed neighbor list row
+   tab[k1 ... k2 - 1] (see NEBR_PACK_ESC); the offsets are converted to
+   indices in the kernel, and rows with partners too far away to be
+   expressed as offsets are held as full indices */
+
+void PairRowPacked (int ip, int j1, short *tab, int k1, int k2)
+{
+  short *dList;
+  int k, nd;
+
+  if (k2 > k1 && tab[k1] == NEBR_PACK_ESC) {
+    k = NEBR_PACK_WIDE (k1);
+    PairRow (ip, j1, NULL, (int *) (tab + k), 0, (k2 - k) / 2, 1);
+  } else {
+    dList = tab + k1;
+    nd = k2 - k1;
+    switch ((pairTabLen > 0) * 2 + ! pairForceOnly) {
+      case 0: PairRowK (ip, j1, NULL, NULL, dList, 0, nd, 1, 0, 0); break;
+      case 1: PairRowK (ip, j1, NULL, NULL, dList, 0, nd, 1, 0, 1); break;
+      case 2: PairRowK (ip, j1, NULL, NULL, dList, 0, nd, 1, 1, 0); break;
+      case 3: PairRowK (ip, j1, NULL, NULL, dList, 0, nd, 1, 1, 1); break;
+    }
+  }
+}
+
+#endif
+
+/* interactions between particle cluster c1 and the clusters in
+   cList (clusters are runs of cSize consecutive particles, at most
+   PAIR_CLUST_MAX, the last possibly shorter, out of np); each block of
+   partner coordinates is loaded once and its forces are accumulated
+   over the members of c1, whose own forces are only reduced at the
+   end; if the partner is c1 itself only pairs with j > i are included;
+   the minimum image convention is always applied */
+
+PAIR_KERNEL void PairClusterRowK (int ip, int c1, int *cList, int nc,
+   int cSize, int np, int tab, int energy)
+{
+  SVReal dx, dy, fc, fcx, fcy, fxi[PAIR_CLUST_MAX], fxj,
+     fyi[PAIR_CLUST_MAX], fyj, lx, ly, lxi, lyi, rr, rrCut, u, uS,
+     uShift, vS, xj, yj;
+#if NDIM == 3
+  SVReal dz, fcz, fzi[PAIR_CLUST_MAX], fzj, lz, lzi, zj;
+#endif
+  SVMask m, mj;
+  int c, i, iBeg, iEnd, jBeg, jEnd, k, l;
+
+  lx = SVSet1 (region.x);
+  ly = SVSet1 (region.y);
+  lxi = SVSet1 (1. / region.x);
+  lyi = SVSet1 (1. / region.y);
+#if NDIM == 3
+  lz = SVSet1 (region.z);
+  lzi = SVSet1 (1. / region.z);
+#endif
+  rrCut = SVSet1 (pairRrCut);
+  uShift = SVSet1 (pairUShift);
+  uS = pairUSumV[ip];
+  vS = pairVirSumV[ip];
+  iBeg = c1 * cSize;
+  iEnd = Min (iBeg + cSize, np);
+  for (i = iBeg; i < iEnd; i ++) {
+    fxi[i - iBeg] = fyi[i - iBeg] = SVZero ();
+#if NDIM == 3
+    fzi[i - iBeg] = SVZero ();
+#endif
+  }
+  for (c = 0; c < nc; c ++) {
+    jBeg = cList[c] * cSize;
+    jEnd = Min (jBeg + cSize, np);
+    for (k = jBeg; k < jEnd; k += SIMD_LEN) {
+      mj = SVMaskN (Min (SIMD_LEN, jEnd - k));
+      xj = SVLoadM (rS.x + k, mj);
+      yj = SVLoadM (rS.y + k, mj);
+      fxj = fyj = SVZero ();
+#if NDIM == 3
+      zj = SVLoadM (rS.z + k, mj);
+      fzj = SVZero ();
+#endif
+      for (i = iBeg; i < iEnd; i ++) {
+        m = mj;
+        if (jBeg == iBeg) {
+          l = i + 1 - k;
+          if (l >= SIMD_LEN) continue;
+          if (l > 0) m = SVMaskAndNot (m, SVMaskN (l));
+        }
+        dx = SVSub (SVSet1 (rS.x[i]), xj);
+        dy = SVSub (SVSet1 (rS.y[i]), yj);
+        dx = SVSub (dx, SVMul (lx, SVRint (SVMul (dx, lxi))));
+        dy = SVSub (dy, SVMul (ly, SVRint (SVMul (dy, lyi))));
+        rr = SVAdd (SVMul (dx, dx), SVMul (dy, dy));
+#if NDIM == 3
+        dz = SVSub (SVSet1 (rS.z[i]), zj);
+        dz = SVSub (dz, SVMul (lz, SVRint (SVMul (dz, lzi))));
+        rr = SVAdd (rr, SVMul (dz, dz));
+#endif
+        m = SVMaskAnd (m, SVCmpLt (rr, rrCut));
+        if (! SVMaskAny (m)) continue;
+        PairLawV (rr, m, &fc, energy ? &u : NULL, tab);
+        fc = SVSelect (m, fc);
+        if (energy) {
+          uS = SVAdd (uS, SVSelect (m, SVAdd (u, uShift)));
+          vS = SVAdd (vS, SVMul (fc, rr));
+        }
+        fcx = SVMul (fc, dx);
+        fcy = SVMul (fc, dy);
+        fxi[i - iBeg] = SVAdd (fxi[i - iBeg], fcx);
+        fyi[i - iBeg] = SVAdd (fyi[i - iBeg], fcy);
+        fxj = SVAdd (fxj, fcx);
+        fyj = SVAdd (fyj, fcy);
+#if NDIM == 3
+        fcz = SVMul (fc, dz);
+        fzi[i - iBeg] = SVAdd (fzi[i - iBeg], fcz);
+        fzj = SVAdd (fzj, fcz);
+#endif
+      }
+      SVStoreM (raS.x + k, SVSub (SVLoadM (raS.x + k, mj), fxj), mj);
+      SVStoreM (raS.y + k, SVSub (SVLoadM (raS.y + k, mj), fyj), mj);
+#if NDIM == 3
+      SVStoreM (raS.z + k, SVSub (SVLoadM (raS.z + k, mj), fzj), mj);
+#endif
+    }
+  }
+  for (i = iBeg; i < iEnd; i ++) {
+    raS.x[i] += SVSum (fxi[i - iBeg]);
+    raS.y[i] += SVSum (fyi[i - iBeg]);
+#if NDIM == 3
+    raS.z[i] += SVSum (fzi[i - iBeg]);
+#endif
+  }
+  pairUSumV[ip] = uS;
+  pairVirSumV[ip] = vS;
+}
+
+void PairClusterRow (int ip, int c1, int *cList, int nc, int cSize, int np)
+{
+  switch ((pairTabLen > 0) * 2 + ! pairForceOnly) {
+    case 0: PairClusterRowK (ip, c1, cList, nc, cSize, np, 0, 0); break;
+    case 1: PairClusterRowK (ip, c1, cList, nc, cSize, np, 0, 1); break;
+    case 2: PairClusterRowK (ip, c1, cList, nc, cSize, np, 1, 0); break;
+    case 3: PairClusterRowK (ip, c1, cList, nc, cSize, np, 1, 1); break;
+  }
+}
+
+/* single precision LJ interactions of slot k of the partner buffer pF
+   with the slots that follow it, up to nb; the forces are converted to
+   double and accumulated in pA, as are the energy and virial (if
+   energy is set) */
+
+PAIR_KERNEL void PairRowFK (int ip, VecRSF *pF, VecRS *pA, int k, int nb,
+   int energy)
+{
+  SFReal dx, dy, fc, fcx, fcy, one, rr, rrCut, rri, rri3, u, uShift, xi,
+     yi;
+  SVReal fa, fxi, fyi, uS, vS;
+#if NDIM == 3
+  SFReal dz, fcz, zi;
+  SVReal fzi;
+#endif
+  SFMask m, mb;
+  SVMask mh, ml;
+  int l;
+
+  xi = SFSet1 (pF->x[k]);
+  yi = SFSet1 (pF->y[k]);
+  fxi = fyi = SVZero ();
+#if NDIM == 3
+  zi = SFSet1 (pF->z[k]);
+  fzi = SVZero ();
+#endif
+  one = SFSet1 (1.);
+  rrCut = SFSet1 (pairRrCut);
+  uShift = SFSet1 (pairUShift);
+  uS = pairUSumV[ip];
+  vS = pairVirSumV[ip];
+  for (l = k + 1; l < nb; l += SF_LEN) {
+    mb = SFMaskN (Min (SF_LEN, nb - l));
+    dx = SFSub (xi, SFLoadM (pF->x + l, mb));
+    dy = SFSub (yi, SFLoadM (pF->y + l, mb));
+    rr = SFAdd (SFMul (dx, dx), SFMul (dy, dy));
+#if NDIM == 3
+    dz = SFSub (zi, SFLoadM (pF->z + l, mb));
+    rr = SFAdd (rr, SFMul (dz, dz));
+#endif
+    m = SFMaskAnd (mb, SFCmpLt (rr, rrCut));
+    if (! SFMaskAny (m)) continue;
+    rri = SFDiv (one, rr);
+    rri3 = SFMul (SFMul (rri, rri), rri);
+    fc = SFSelect (m, SFMul (SFMul (SFSet1 (48.), rri3),
+       SFMul (SFSub (rri3, SFSet1 (0.5)), rri)));
+    if (energy) {
+      u = SFSelect (m, SFAdd (SFMul (SFMul (SFSet1 (4.), rri3),
+         SFSub (rri3, one)), uShift));
+      uS = SVAdd (uS, SVAdd (SFCvtLo (u), SFCvtHi (u)));
+      rr = SFMul (fc, rr);
+      vS = SVAdd (vS, SVAdd (SFCvtLo (rr), SFCvtHi (rr)));
+    }
+    ml = SFMaskLo (mb);
+    mh = SFMaskHi (mb);
+    fcx = SFMul (fc, dx);
+    fcy = SFMul (fc, dy);
+    PAIR_ACC_F (x);
+    PAIR_ACC_F (y);
+#if NDIM == 3
+    fcz = SFMul (fc, dz);
+    PAIR_ACC_F (z);
+#endif
+  }
+  pA->x[k] += SVSum (fxi);
+  pA->y[k] += SVSum (fyi);
+#if NDIM == 3
+  pA->z[k] += SVSum (fzi);
+#endif
+  pairUSumV[ip] = uS;
+  pairVirSumV[ip] = vS;
+}
+
+void PairRowF (int ip, VecRSF *pF, VecRS *pA, int k, int nb)
+{
+  if (pairForceOnly) PairRowFK (ip, pF, pA, k, nb, 0);
+  else PairRowFK (ip, pF, pA, k, nb, 1);
+}
+
+/* for the all-pairs kernel the np particles are divided into an odd
+   number of blocks of about PAIR_TILE (rounded to whole SIMD vectors),
+   small enough for a pair of blocks to stay in cache; the pairs of
+   blocks are processed in nPairBlock rounds, as in a round-robin
+   tournament, so that every block occurs once per round and the tiles
+   of a round can be handled by different threads */
+
+void SetPairBlocks (int np)
+{
+  nPairBlock = (np + PAIR_TILE - 1) / PAIR_TILE;
+  if (nPairBlock % 2 == 0) ++ nPairBlock;
+  pairBlockSize = ((np + nPairBlock - 1) / nPairBlock + SIMD_LEN - 1) /
+     SIMD_LEN * SIMD_LEN;
+  pairBlockNp = np;
+}
+
+/* interactions between the particles of blocks bi and bj (or, if they
+   are the same, within the block) using the minimum image convention;
+   the coordinates must be gathered in the original order */
+
+void PairTile (int ip, int bi, int bj)
+{
+  int i, iBeg, iEnd, jBeg, jEnd;
+
+  iBeg = bi * pairBlockSize;
+  iEnd = Min (iBeg + pairBlockSize, pairBlockNp);
+  jBeg = bj * pairBlockSize;
+  jEnd = Min (jBeg + pairBlockSize, pairBlockNp);
+  for (i = iBeg; i < iEnd; i ++) {
+    if (bi == bj) PairRow (ip, i, &rS, NULL, i + 1, jEnd - i - 1, 1);
+    else PairRow (ip, i, &rS, NULL, jBeg, jEnd - jBeg, 1);
+  }
+}
+
+/* tile t (out of (nPairBlock + 1) / 2) of round r; tile 0 is the block
+   b left over in this round (2 b = r modulo nPairBlock) paired with
+   itself, the others pair the blocks t either side of b */
+
+void PairTileRound (int ip, int r, int t)
+{
+  int b, n;
+
+  n = nPairBlock;
+  b = r * (n + 1) / 2 % n;
+  if (t == 0) PairTile (ip, b, b);
+  else PairTile (ip, (b + t) % n, (b - t + n) % n);
+}
+
+#ifdef CELL_BIN_DEFS
+
+/* single precision working copy in cell order, each particle held as
+   its offset from the origin of its cell */
+
+void GatherPairCoordsF ()
+{
+  VecR o, w;
+  VecI mv;
+  int j, m, n;
+
+  VDiv (w, region, cells);
+  for (m = 0; m < VProd (cells); m ++) {
+    VCellVec (mv, m);
+    VMul (o, mv, w);
+    VVSAdd (o, -0.5, region);
+    DO_CELL_SLOT (j, m) {
+      rF.x[j] = mol[cellList[j]].r.x - o.x;
+      rF.y[j] = mol[cellList[j]].r.y - o.y;
+#if NDIM == 3
+      rF.z[j] = mol[cellList[j]].r.z - o.z;
+#endif
+    }
+  }
+  DO_MOL VSZero (raS, n);
+  for (m = 0; m < PAIR_THREAD_MAX; m ++)
+     pairUSumV[m] = pairVirSumV[m] = SVZero ();
+}
+
+/* interactions of the particles in cell m1 with those in the half
+   shell of cells around it (see SetCellStencil), using the cell slots
+   (the coordinates must be gathered in cell order); buf is private to
+   thread ip */
+
+void PairCell (int ip, int m1, int *buf)
+{
+  VecI m1v, m2v;
+  int j2, k, m2, nb, nb1, offset;
+
+  if (CELL_EMPTY (m1)) return;
+  VCellVec (m1v, m1);
+  nb = 0;
+  nb1 = cellStart[m1 + 1] - cellStart[m1];
+  if (CELL_INTERIOR (m1v)) {
+    for (k = 0; k < nCellOffRow; k ++) {
+      m2 = m1 + cellOffRow[k];
+      for (j2 = cellStart[m2]; j2 < cellStart[m2 + cellOffRowLen[k]]; j2 ++)
+         buf[nb ++] = j2;
+    }
+  } else {
+    for (offset = 0; offset < nCellOff; offset ++) {
+      VAdd (m2v, m1v, cellOff[offset]);
+      VCellWrapIdxAll ();
+      m2 = VLinear (m2v, cells);
+      DO_CELL_SLOT (j2, m2) buf[nb ++] = j2;
+    }
+  }
+  for (k = 0; k < nb1; k ++)
+     PairRow (ip, buf[k], NULL, buf + k + 1, 0, nb - k - 1, 1);
+}
+
+/* single precision version of PairCell; the partners of the particles
+   in cell m1 are copied to the buffer of thread ip with positions
+   relative to the origin of m1 (taken from the cell offsets, so no
+   wrapping is needed and the values remain small), and the forces
+   collected there are added to raS at the end */
+
+void PairCellF (int ip, int m1, int *buf)
+{
+  VecR d, w;
+  VecI m1v, m2v;
+  VecRS *pA;
+  VecRSF *pF;
+  int j2, k, m2, nb, nb1, offset;
+
+  if (CELL_EMPTY (m1)) return;
+  pA = &pairBufA[ip];
+  pF = &pairBufF[ip];
+  VCellVec (m1v, m1);
+  VDiv (w, region, cells);
+  nb = 0;
+  nb1 = cellStart[m1 + 1] - cellStart[m1];
+  for (offset = 0; offset < nCellOff; offset ++) {
+    VAdd (m2v, m1v, cellOff[offset]);
+    VMul (d, cellOff[offset], w);
+    VCellWrapIdxAll ();
+    m2 = VLinear (m2v, cells);
+    DO_CELL_SLOT (j2, m2) {
+      buf[nb] = j2;
+      pF->x[nb] = rF.x[j2] + d.x;
+      pF->y[nb] = rF.y[j2] + d.y;
+#if NDIM == 3
+      pF->z[nb] = rF.z[j2] + d.z;
+#endif
+      VSZero (*pA, nb);
+      ++ nb;
+    }
+  }
+  for (k = 0; k < nb1; k ++) PairRowF (ip, pF, pA, k, nb);
+  for (k = 0; k < nb; k ++) {
+    raS.x[buf[k]] += pA->x[k];
+    raS.y[buf[k]] += pA->y[k];
+#if NDIM == 3
+    raS.z[buf[k]] += pA->z[k];
+#endif
+  }
+}
+
+#endif
+
@@ -0,0 +1,45 @@
+
+#ifndef PAIR_DEFS
+
+#define PAIR_DEFS
+
+#include "in_simd.h"
+
+#define PAIR_CLUST_MAX  16
+#define PAIR_TAB_CHECK  10
+#define PAIR_TAB_LEN  2000
+#define PAIR_TAB_RMIN  0.5
+#define PAIR_TAB_STRIDE  8
+#define PAIR_THREAD_MAX  256
+#define PAIR_TILE  256
+
+/* kernels taking constant option arguments are forced inline into
+   small wrappers, one instance per combination of options; the option
+   tests are cheap in themselves (they are well predicted), the gain
+   comes where an option removes work, as the energy option does */
+
+#define PAIR_KERNEL  static inline __attribute__ ((always_inline))
+
+#define PAIR_ACC_F(t)                                       \
+   fa = SFCvtLo (fc ## t);                                  \
+   f ## t ## i = SVAdd (f ## t ## i, fa);                   \
+   SVStoreM (pA->t + l, SVSub (SVLoadM (pA->t + l, ml),     \
+   fa), ml);                                                \
+   fa = SFCvtHi (fc ## t);                                  \
+   f ## t ## i = SVAdd (f ## t ## i, fa);                   \
+   SVStoreM (pA->t + l + SIMD_LEN, SVSub (SVLoadM (pA->t    \
+   + l + SIMD_LEN, mh), fa), mh)
+
+enum {PAIR_LJ, PAIR_LJ_CUT, PAIR_LJ_SPLINE, PAIR_SW, PAIR_LAW_NUM};
+char *pairLawName[] = {"lj", "ljcut", "ljspline", "sw"};
+
+VecRS pairBufA[PAIR_THREAD_MAX], rS, raS;
+VecRSF pairBufF[PAIR_THREAD_MAX], rF;
+real *pairTab, pairRrCut, pairRrTabMin, pairTabScale, pairUShift,
+   pairUSum, pairVirSum, pairSplineA2, pairSplineA3, pairSwitch;
+int nPairBlock, pairBlockNp, pairBlockSize, pairForceOnly, pairLawId,
+   pairTabLen;
+SVReal pairUSumV[PAIR_THREAD_MAX], pairVirSumV[PAIR_THREAD_MAX];
+
+#endif
+
@@ -13,6 +13,13 @@ void AdjustPressure (void);
 void AdjustQuat (void);
 void AdjustTemp (void);
 void AllocArrays (void);
+void AllocCellBins (int, int);
+void AllocCellMoves (int, int);
+void AllocGearPC (int);
+void AllocNebrAsync (int);
+void AllocNebrClusters (int);
+void AllocPairFloat (int, int);
+void AllocReorder (void);
 void AnalClusterSize (void);
 void AnalVorPoly (void);
 void AnlzConstraintDevs (void);
@@ -23,6 +30,8 @@ void ApplyThermostat (void);
 void ApplyWallBoundaryCond (void);
 void AssignMpCells (void);
 void AssignToChain (void);
+void BenchThreads (int);
+void BinCells (VecR *, int, int);
 void BisectPlane (void);
 void BuildClusters (void);
 void BuildConstraintMatrix (void);
@@ -32,10 +41,15 @@ void BuildLinkMmat (real *, int);
 void BuildLinkPhimatT (real *, int);
 void BuildLinkRotmatT (RMat *, real, real);
 void BuildLinkXYvecs (int);
+void BuildNebrClusters (int);
 void BuildNebrList (void);
 void *BuildNebrListT (void *);
+int  BuildNebrRows (VecR *, int, int, int, real, int *, int *, int);
+void BuildNebrTab (VecR *, int, int, real);
+void BuildPairTab (int);
 void BuildRotMatrix (RMat *, Quat *, int);
 void BuildStepRmatT (RMat *, VecR *);
+int  CellMoveCmp (const void *, const void *);
 void CombineMpCell (void);
 void CompressClusters (void);
 void ComputeAccelsQ (void);
@@ -66,6 +80,7 @@ void CorrectorStepBox (void);
 void CorrectorStepPT (void);
 void CorrectorStepQ (void);
 void CorrectorStepS (void);
+unsigned int CurveKey (unsigned int *);
 void DefineMol (void);
 void DeleteAllMolEvents (int id);
 void DeleteEvent (int);
@@ -76,10 +91,12 @@ void DoParlMove (void);
 void DoUnpackInt (int *, int);
 void DoUnpackReal (real *, int);
 void DriveFlow (void);
+int  EnergyStep (void);
 void ErrExit (int);
 void EulerToQuat (Quat *, real *);
 void EvalMpCell (void);
 void EvalMolCount (void);
+void EvalCellBlockCost (void);
 void EvalChainProps (void);
 void EvalDiffusion (void);
 void EvalDihedAngCorr (void);
@@ -92,6 +109,7 @@ void EvalMpL (MpTerms *, VecR *, int);
 void EvalMpM (MpTerms *, VecR *, int);
 void EvalMpProdLL (MpTerms *, MpTerms *, MpTerms *, int);
 void EvalMpProdLM (MpTerms *, MpTerms *, MpTerms *, int);
+void EvalPairLaw (real, real *, real *);
 void EvalProfile (void);
 void EvalProps (void);
 void EvalRdf (void);
@@ -102,6 +120,9 @@ void EvalVelDist (void);
 void FftComplex (Cmplx *, int);
 void FindDistVerts (void);
 void FindTestSites (int);
+int  FinishNebrAsync (VecR *, int, int, real, int);
+void GatherPairCoords (int *);
+void GatherPairCoordsF (void);
 void GatherWellSepLo (void);
 void GenSiteCoords (void);
 void GetCheckpoint (void);
@@ -109,6 +130,7 @@ int  GetConfig (void);
 int  GetGridAverage (void);
 int  GetNameList (int, char **);
 void GridAverage (int);
+void GrowNebrTab (void);
 void InitAccels (void);
 void InitAngAccels (void);
 void InitAngCoords (void);
@@ -128,6 +150,7 @@ void InitRand (int);
 void InitSlaves (void);
 void InitSpacetimeCorr (void);
 void InitState (void);
+void InitThreads (void);
 void InitVacf (void);
 void InitVels (void);
 void InitVorPoly (void);
@@ -140,11 +163,23 @@ void MeasureTrajDev (void);
 void MulMat (real *, real *, real *, int);
 void MulMatVec (real *, real *, real *, int);
 void MultipoleCalc (void);
+void *NebrAsyncWorker (void *);
 void NebrParlProcs (void);
 void NextEvent (void);
 void PackCopiedData (int, int, int *, int);
 void PackMovedData (int, int, int *, int);
+void PackNebrRows (VecR *, int, int, real);
 void PackValList (ValList *, int);
+void PairCell (int, int, int *);
+void PairCellF (int, int, int *);
+void PairClusterRow (int, int, int *, int, int, int);
+void PairRow (int, int, VecRS *, int *, int, int, int);
+void PairRowF (int, VecRSF *, VecRS *, int, int);
+void PairRowPacked (int, int, short *, int, int);
+void PairTabSpline (real *, real, real, int, real, real *);
+void PairTile (int, int, int);
+void PairTileRound (int, int, int);
+void PermuteGearPC (int *, int);
 void PerturbCoords (void);
 void PerturbTrajDev (void);
 void PolyGeometry (void);
@@ -161,11 +196,14 @@ void PrintDihedAngCorr (FILE *);
 void PrintFreePath (FILE *);
 void PrintHelp (char *);
 void PrintNameList (FILE *);
+void PrintNebrStats (FILE *, int);
 void PrintPairEng (FILE *);
+void PrintPairTab (FILE *);
 void PrintProfile (FILE *);
 void PrintRdf (FILE *);
 void PrintSpacetimeCorr (FILE *);
 void PrintSummary (FILE *);
+void PrintThreadStats (FILE *);
 void PrintTrajDev (FILE *);
 void PrintVacf (FILE *);
 void PrintVelDist (FILE *);
@@ -184,18 +222,29 @@ void PutPlotData (void);
 void PutGridAverage (void);
 real RandR (void);
 void RemoveOld (void);
+void ReorderMols (void);
 void RepackMolArray (void);
 void ReplicateMols (void);
+void ResizeNebrTab (int);
 void RestoreConstraints (void);
+void RunThreads (void *(*) (void *), int);
+void SaveNebrRef (VecR *, int, int);
 void ScaleCoords (void);
 void ScaleVels (void);
 void ScanIntTree (void);
+void ScatterPairAccels (int *);
 void ScheduleEvent (int, int, real);
 void SetMolType (void);
 void SetBase (void);
+void SetCellColors (void);
+void SetCellStencil (real);
 void SetCellSize (void);
 void SetMolSizes (void);
+void SetPairBlocks (int);
+real SetPairLaw (char *);
+void SetPairParams (real, real);
 void SetParams (void);
+void SetThreadTasks (int, int, int *, real *);
 void SetupFiles (void);
 void SetupInterrupt (void);
 void SetupJob (void);
@@ -205,13 +254,25 @@ void SingleStep (void);
 void SolveCubic (real *, real *);
 void SolveLineq (real *, real *, int);
 void Sort (real *, int *, int);
+void SortCellBins (int, int);
+void StartNebrAsync (VecR *, int, int, real);
 void StartRun (void);
+void StopThreads (void);
 void SubdivCells (void);
+real ThreadCpuTime (void);
+void ThreadFirstTouch (void *, size_t);
+int  ThreadNextTask (int);
+void *ThreadNull (void *);
+void ThreadSync (void);
+void *ThreadTouchT (void *);
+void *ThreadWorker (void *);
+void TuneNebrShell (void);
 void UnpackCopiedData (int);
 void UnpackMovedData (int);
 void UnpackValList (ValList *, int);
 void UnscaleCoords (void);
 void UpdateMol (int);
+void UpdateCellBins (int, int);
 void UpdateCellSize (void);
 void UpdateSystem (void);
 void VRand (VecR *);
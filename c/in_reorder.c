@@ -0,0 +1,97 @@
+
+/* periodic reordering of mol[] along a space-filling curve; molId[n]
+   is the original index of the particle now in slot n, molSlot[id] is
+   the inverse, so output can be produced in original order; reordPerm
+   maps new slots to old for permuting any per-particle side arrays */
+
+void AllocReorder ()
+{
+  int n;
+
+  AllocMem (molId, nMol, int);
+  AllocMem (molSlot, nMol, int);
+  AllocMem (reordKey, nMol, unsigned int);
+  AllocMem (reordPerm, nMol, int);
+  AllocMem (reordPerm2, nMol, int);
+  AllocMem (molReordBuf, nMol, Mol);
+  DO_MOL {
+    molId[n] = n;
+    molSlot[n] = n;
+  }
+}
+
+/* curve index from integer coordinates x[0 ... NDIM - 1] of CURVE_BITS
+   bits each; Hilbert order uses Skilling's transposition, Morton order
+   just interleaves the bits */
+
+unsigned int CurveKey (unsigned int *x)
+{
+  unsigned int key, p, q, t;
+  int b, i;
+
+  if (reorderCurve == CURVE_HILBERT) {
+    for (q = 1 << (CURVE_BITS - 1); q > 1; q >>= 1) {
+      p = q - 1;
+      for (i = 0; i < NDIM; i ++) {
+        if (x[i] & q) x[0] ^= p;
+        else {
+          t = (x[0] ^ x[i]) & p;
+          x[0] ^= t;
+          x[i] ^= t;
+        }
+      }
+    }
+    for (i = 1; i < NDIM; i ++) x[i] ^= x[i - 1];
+    t = 0;
+    for (q = 1 << (CURVE_BITS - 1); q > 1; q >>= 1) {
+      if (x[NDIM - 1] & q) t ^= q - 1;
+    }
+    for (i = 0; i < NDIM; i ++) x[i] ^= t;
+  }
+  key = 0;
+  for (b = CURVE_BITS - 1; b >= 0; b --) {
+    for (i = 0; i < NDIM; i ++) key = (key << 1) | ((x[i] >> b) & 1);
+  }
+  return (key);
+}
+
+void ReorderMols ()
+{
+  VecR w;
+  real ww[NDIM];
+  unsigned int x[NDIM];
+  void *t;
+  int cnt[257], b, i, k, n, *pt;
+
+  DO_MOL {
+    VDiv (w, mol[n].r, region);
+    VAddCon (w, w, 0.5);
+    VScale (w, 1 << CURVE_BITS);
+    VToLin (ww, 0, w);
+    for (i = 0; i < NDIM; i ++)
+       x[i] = Clamp ((int) ww[i], 0, (1 << CURVE_BITS) - 1);
+    reordKey[n] = CurveKey (x);
+    reordPerm[n] = n;
+  }
+  for (b = 0; b < NDIM * CURVE_BITS; b += 8) {
+    for (k = 0; k <= 256; k ++) cnt[k] = 0;
+    DO_MOL ++ cnt[((reordKey[reordPerm[n]] >> b) & 255) + 1];
+    for (k = 0; k < 256; k ++) cnt[k + 1] += cnt[k];
+    DO_MOL reordPerm2[cnt[(reordKey[reordPerm[n]] >> b) & 255] ++] =
+       reordPerm[n];
+    pt = reordPerm;
+    reordPerm = reordPerm2;
+    reordPerm2 = pt;
+  }
+  DO_MOL ((Mol *) molReordBuf)[n] = mol[reordPerm[n]];
+  t = mol;
+  mol = (Mol *) molReordBuf;
+  molReordBuf = t;
+  DO_MOL reordPerm2[n] = molId[reordPerm[n]];
+  DO_MOL {
+    molId[n] = reordPerm2[n];
+    molSlot[molId[n]] = n;
+  }
+  reorderNow = 0;
+}
+
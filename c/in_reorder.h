@@ -0,0 +1,16 @@
+
+#ifndef REORDER_DEFS
+
+#define REORDER_DEFS
+
+#define CURVE_BITS  10
+
+enum {CURVE_MORTON, CURVE_HILBERT};
+
+void *molReordBuf;
+unsigned int *reordKey;
+int *molId, *molSlot, *reordPerm, *reordPerm2, reorderCurve, reorderNow,
+   stepReorder;
+
+#endif
+
@@ -0,0 +1,231 @@
+
+#ifndef SIMD_DEFS
+
+#define SIMD_DEFS
+
+#if defined (__AVX512F__) && ! defined (NO_SIMD)
+
+#include <immintrin.h>
+
+#define SIMD_LEN  8
+
+typedef __m512d SVReal;
+typedef __mmask8 SVMask;
+typedef __m256i SVIdx;
+
+#define SVSet1(s)       _mm512_set1_pd (s)
+#define SVZero()        _mm512_setzero_pd ()
+#define SVAdd(a, b)     _mm512_add_pd (a, b)
+#define SVSub(a, b)     _mm512_sub_pd (a, b)
+#define SVMul(a, b)     _mm512_mul_pd (a, b)
+#define SVDiv(a, b)     _mm512_div_pd (a, b)
+#define SVMax(a, b)     _mm512_max_pd (a, b)
+#define SVFloor(a)                                          \
+   _mm512_roundscale_pd (a, _MM_FROUND_TO_NEG_INF |         \
+   _MM_FROUND_NO_EXC)
+#define SVRint(a)                                           \
+   _mm512_roundscale_pd (a, _MM_FROUND_TO_NEAREST_INT |     \
+   _MM_FROUND_NO_EXC)
+#define SVLoad(p)       _mm512_loadu_pd (p)
+#define SVLoadM(p, m)   _mm512_maskz_loadu_pd (m, p)
+#define SVStore(p, a)   _mm512_storeu_pd (p, a)
+#define SVStoreM(p, a, m)  _mm512_mask_storeu_pd (p, m, a)
+#define SVLoadIdxM(ip, m)  _mm256_maskz_loadu_epi32 (m, ip)
+#define SVGatherM(b, ip, m)                                 \
+   _mm512_mask_i32gather_pd (_mm512_setzero_pd (), m,       \
+   SVLoadIdxM (ip, m), b, 8)
+#define SVScatterSubM(b, ip, a, m)                          \
+   {__m256i vi_ = SVLoadIdxM (ip, m);                       \
+   _mm512_mask_i32scatter_pd (b, m, vi_, _mm512_sub_pd (    \
+   _mm512_mask_i32gather_pd (_mm512_setzero_pd (), m, vi_,  \
+   b, 8), a), 8);}
+#define SVToIdx(a)      _mm512_cvttpd_epi32 (a)
+#define SVGatherIdxM(b, vi, m)                              \
+   _mm512_mask_i32gather_pd (_mm512_setzero_pd (), m, vi, b, 8)
+#define SVLoadIdxD(p, j)                                    \
+   _mm256_add_epi32 (_mm256_cvtepi16_epi32 (_mm_loadu_si128 \
+   ((__m128i *) (p))), _mm256_set1_epi32 (j))
+#define SVScatterSubIdxM(b, vi, a, m)                       \
+   _mm512_mask_i32scatter_pd (b, m, vi, _mm512_sub_pd (     \
+   _mm512_mask_i32gather_pd (_mm512_setzero_pd (), m, vi,   \
+   b, 8), a), 8)
+#define SVCmpLt(a, b)   _mm512_cmp_pd_mask (a, b, _CMP_LT_OQ)
+#define SVMaskN(n)      ((__mmask8) ((1u << (n)) - 1))
+#define SVMaskAnd(m1, m2)  ((m1) & (m2))
+#define SVMaskAndNot(m1, m2)  ((m1) & ~ (m2))
+#define SVMaskAny(m)    ((m) != 0)
+#define SVSelect(m, a)  _mm512_maskz_mov_pd (m, a)
+#define SVSum(a)        _mm512_reduce_add_pd (a)
+
+#define SF_LEN  16
+
+typedef __m512 SFReal;
+typedef __mmask16 SFMask;
+
+#define SFSet1(s)       _mm512_set1_ps (s)
+#define SFAdd(a, b)     _mm512_add_ps (a, b)
+#define SFSub(a, b)     _mm512_sub_ps (a, b)
+#define SFMul(a, b)     _mm512_mul_ps (a, b)
+#define SFDiv(a, b)     _mm512_div_ps (a, b)
+#define SFLoadM(p, m)   _mm512_maskz_loadu_ps (m, p)
+#define SFCmpLt(a, b)   _mm512_cmp_ps_mask (a, b, _CMP_LT_OQ)
+#define SFMaskN(n)      ((__mmask16) ((1u << (n)) - 1))
+#define SFMaskAnd(m1, m2)  ((m1) & (m2))
+#define SFMaskAny(m)    ((m) != 0)
+#define SFMaskLo(m)     ((__mmask8) (m))
+#define SFMaskHi(m)     ((__mmask8) ((m) >> 8))
+#define SFSelect(m, a)  _mm512_maskz_mov_ps (m, a)
+#define SFCvtLo(a)      _mm512_cvtps_pd (_mm512_castps512_ps256 (a))
+#define SFCvtHi(a)                                          \
+   _mm512_cvtps_pd (_mm256_castpd_ps (                      \
+   _mm512_extractf64x4_pd (_mm512_castps_pd (a), 1)))
+
+#elif defined (__AVX2__) && ! defined (NO_SIMD)
+
+#include <immintrin.h>
+
+#define SIMD_LEN  4
+
+typedef __m256d SVReal;
+typedef __m256d SVMask;
+typedef __m128i SVIdx;
+
+#define SVSet1(s)       _mm256_set1_pd (s)
+#define SVZero()        _mm256_setzero_pd ()
+#define SVAdd(a, b)     _mm256_add_pd (a, b)
+#define SVSub(a, b)     _mm256_sub_pd (a, b)
+#define SVMul(a, b)     _mm256_mul_pd (a, b)
+#define SVDiv(a, b)     _mm256_div_pd (a, b)
+#define SVMax(a, b)     _mm256_max_pd (a, b)
+#define SVFloor(a)      _mm256_floor_pd (a)
+#define SVRint(a)                                           \
+   _mm256_round_pd (a, _MM_FROUND_TO_NEAREST_INT |          \
+   _MM_FROUND_NO_EXC)
+#define SVLoad(p)       _mm256_loadu_pd (p)
+#define SVLoadM(p, m)   _mm256_maskload_pd (p, _mm256_castpd_si256 (m))
+#define SVStore(p, a)   _mm256_storeu_pd (p, a)
+#define SVStoreM(p, a, m)                                   \
+   _mm256_maskstore_pd (p, _mm256_castpd_si256 (m), a)
+#define SVLoadIdxM(ip, m)                                   \
+   _mm_maskload_epi32 (ip, _mm256_cvtpd_epi32 (m))
+#define SVGatherM(b, ip, m)                                 \
+   _mm256_mask_i32gather_pd (_mm256_setzero_pd (), b,       \
+   SVLoadIdxM (ip, m), m, 8)
+#define SVScatterSubM(b, ip, a, m)                          \
+   {double t_[4];                                           \
+   int l_, m_;                                              \
+   _mm256_storeu_pd (t_, a);                                \
+   m_ = _mm256_movemask_pd (m);                             \
+   for (l_ = 0; l_ < 4; l_ ++) {                            \
+     if (m_ & (1 << l_)) (b)[(ip)[l_]] -= t_[l_];           \
+   }}
+#define SVToIdx(a)      _mm256_cvttpd_epi32 (a)
+#define SVGatherIdxM(b, vi, m)                              \
+   _mm256_mask_i32gather_pd (_mm256_setzero_pd (), b, vi, m, 8)
+#define SVLoadIdxD(p, j)                                    \
+   _mm_add_epi32 (_mm_cvtepi16_epi32 (_mm_loadl_epi64       \
+   ((__m128i *) (p))), _mm_set1_epi32 (j))
+#define SVScatterSubIdxM(b, vi, a, m)                       \
+   {int i_[4];                                              \
+   _mm_storeu_si128 ((__m128i *) i_, vi);                   \
+   SVScatterSubM (b, i_, a, m);}
+#define SVCmpLt(a, b)   _mm256_cmp_pd (a, b, _CMP_LT_OQ)
+#define SVMaskN(n)                                          \
+   _mm256_cmp_pd (_mm256_set_pd (3., 2., 1., 0.),           \
+   _mm256_set1_pd (n), _CMP_LT_OQ)
+#define SVMaskAnd(m1, m2)  _mm256_and_pd (m1, m2)
+#define SVMaskAndNot(m1, m2)  _mm256_andnot_pd (m2, m1)
+#define SVMaskAny(m)    (_mm256_movemask_pd (m) != 0)
+#define SVSelect(m, a)  _mm256_and_pd (m, a)
+#define SVSum(a)                                            \
+   ({__m128d s_ = _mm_add_pd (_mm256_castpd256_pd128 (a),   \
+   _mm256_extractf128_pd (a, 1));                           \
+   _mm_cvtsd_f64 (_mm_add_sd (s_, _mm_unpackhi_pd (s_, s_)));})
+
+#define SF_LEN  8
+
+typedef __m256 SFReal;
+typedef __m256 SFMask;
+
+#define SFSet1(s)       _mm256_set1_ps (s)
+#define SFAdd(a, b)     _mm256_add_ps (a, b)
+#define SFSub(a, b)     _mm256_sub_ps (a, b)
+#define SFMul(a, b)     _mm256_mul_ps (a, b)
+#define SFDiv(a, b)     _mm256_div_ps (a, b)
+#define SFLoadM(p, m)   _mm256_maskload_ps (p, _mm256_castps_si256 (m))
+#define SFCmpLt(a, b)   _mm256_cmp_ps (a, b, _CMP_LT_OQ)
+#define SFMaskN(n)                                          \
+   _mm256_cmp_ps (_mm256_set_ps (7., 6., 5., 4., 3., 2.,    \
+   1., 0.), _mm256_set1_ps (n), _CMP_LT_OQ)
+#define SFMaskAnd(m1, m2)  _mm256_and_ps (m1, m2)
+#define SFMaskAny(m)    (_mm256_movemask_ps (m) != 0)
+#define SFMaskLo(m)                                         \
+   _mm256_castsi256_pd (_mm256_cvtepi32_epi64 (             \
+   _mm_castps_si128 (_mm256_castps256_ps128 (m))))
+#define SFMaskHi(m)                                         \
+   _mm256_castsi256_pd (_mm256_cvtepi32_epi64 (             \
+   _mm_castps_si128 (_mm256_extractf128_ps (m, 1))))
+#define SFSelect(m, a)  _mm256_and_ps (m, a)
+#define SFCvtLo(a)      _mm256_cvtps_pd (_mm256_castps256_ps128 (a))
+#define SFCvtHi(a)      _mm256_cvtps_pd (_mm256_extractf128_ps (a, 1))
+
+#else
+
+#define SIMD_LEN  1
+
+typedef real SVReal;
+typedef int SVMask;
+typedef int SVIdx;
+
+#define SVSet1(s)       (s)
+#define SVZero()        0.
+#define SVAdd(a, b)     ((a) + (b))
+#define SVSub(a, b)     ((a) - (b))
+#define SVMul(a, b)     ((a) * (b))
+#define SVDiv(a, b)     ((a) / (b))
+#define SVMax(a, b)     Max (a, b)
+#define SVFloor(a)      floor (a)
+#define SVRint(a)       rint (a)
+#define SVLoad(p)       (*(p))
+#define SVLoadM(p, m)   ((m) ? *(p) : 0.)
+#define SVStore(p, a)   *(p) = (a)
+#define SVStoreM(p, a, m)  if (m) *(p) = (a)
+#define SVGatherM(b, ip, m)  ((m) ? (b)[*(ip)] : 0.)
+#define SVScatterSubM(b, ip, a, m)  if (m) (b)[*(ip)] -= (a)
+#define SVToIdx(a)      ((int) (a))
+#define SVGatherIdxM(b, vi, m)  ((m) ? (b)[vi] : 0.)
+#define SVLoadIdxD(p, j)  ((j) + *(p))
+#define SVScatterSubIdxM(b, vi, a, m)  if (m) (b)[vi] -= (a)
+#define SVCmpLt(a, b)   ((a) < (b))
+#define SVMaskN(n)      ((n) > 0)
+#define SVMaskAnd(m1, m2)  ((m1) && (m2))
+#define SVMaskAndNot(m1, m2)  ((m1) && ! (m2))
+#define SVMaskAny(m)    (m)
+#define SVSelect(m, a)  ((m) ? (a) : 0.)
+#define SVSum(a)        (a)
+
+#define SF_LEN  1
+
+typedef float SFReal;
+typedef int SFMask;
+
+#define SFSet1(s)       ((float) (s))
+#define SFAdd(a, b)     ((a) + (b))
+#define SFSub(a, b)     ((a) - (b))
+#define SFMul(a, b)     ((a) * (b))
+#define SFDiv(a, b)     ((a) / (b))
+#define SFLoadM(p, m)   ((m) ? *(p) : 0.f)
+#define SFCmpLt(a, b)   ((a) < (b))
+#define SFMaskN(n)      ((n) > 0)
+#define SFMaskAnd(m1, m2)  ((m1) && (m2))
+#define SFMaskAny(m)    (m)
+#define SFMaskLo(m)     (m)
+#define SFMaskHi(m)     0
+#define SFSelect(m, a)  ((m) ? (a) : 0.f)
+#define SFCvtLo(a)      ((real) (a))
+#define SFCvtHi(a)      0.
+
+#endif
+
+#endif
+
@@ -0,0 +1,70 @@
+
+#ifndef SOA_DEFS
+
+#define SOA_DEFS
+
+#if NDIM == 2
+
+typedef struct {
+  real *x, *y;
+} VecRS;
+
+typedef struct {
+  float *x, *y;
+} VecRSF;
+
+#define AllocMemS(v, n)                                     \
+   AllocMem ((v).x, n, real);                               \
+   AllocMem ((v).y, n, real)
+#define AllocMemSF(v, n)                                    \
+   AllocMem ((v).x, n, float);                              \
+   AllocMem ((v).y, n, float)
+#define VSGet(v, s, n)                                      \
+   VSet (v, (s).x[n], (s).y[n])
+#define VSPut(s, n, v)                                      \
+   (s).x[n] = (v).x,                                        \
+   (s).y[n] = (v).y
+#define VSVSAdd(s, n, s2, v)                                \
+   (s).x[n] += (s2) * (v).x,                                \
+   (s).y[n] += (s2) * (v).y
+#define VSZero(s, n)                                        \
+   (s).x[n] = (s).y[n] = 0.
+
+#endif
+
+#if NDIM == 3
+
+typedef struct {
+  real *x, *y, *z;
+} VecRS;
+
+typedef struct {
+  float *x, *y, *z;
+} VecRSF;
+
+#define AllocMemS(v, n)                                     \
+   AllocMem ((v).x, n, real);                               \
+   AllocMem ((v).y, n, real);                               \
+   AllocMem ((v).z, n, real)
+#define AllocMemSF(v, n)                                    \
+   AllocMem ((v).x, n, float);                              \
+   AllocMem ((v).y, n, float);                              \
+   AllocMem ((v).z, n, float)
+#define VSGet(v, s, n)                                      \
+   VSet (v, (s).x[n], (s).y[n], (s).z[n])
+#define VSPut(s, n, v)                                      \
+   (s).x[n] = (v).x,                                        \
+   (s).y[n] = (v).y,                                        \
+   (s).z[n] = (v).z
+#define VSVSAdd(s, n, s2, v)                                \
+   (s).x[n] += (s2) * (v).x,                                \
+   (s).y[n] += (s2) * (v).y,                                \
+   (s).z[n] += (s2) * (v).z
+#define VSZero(s, n)                                        \
+   (s).x[n] = (s).y[n] = (s).z[n] = 0.
+
+#endif
+
+
+#endif
+
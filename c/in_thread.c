@@ -0,0 +1,258 @@
+
+void InitThreads ()
+{
+  long ip;
+
+  nThread = Max (nThread, 1);
+  AllocMem (pThread, nThread, pthread_t);
+  AllocMem (threadQueue, nThread, ThreadQueue);
+  AllocMem (threadBusy, nThread, real);
+  AllocMem (threadIdle, nThread, real);
+  AllocMem (threadWork, nThread, real);
+  for (ip = 0; ip < nThread; ip ++) threadIdle[ip] = threadWork[ip] = 0.;
+  syncCount = 0;
+  syncSense = 0;
+  for (ip = 1; ip < nThread; ip ++)
+     pthread_create (&pThread[ip], NULL, ThreadWorker, (void *) ip);
+}
+
+/* the workers leave when a null stage is dispatched; the pool can then
+   be recreated with another nThread */
+
+void StopThreads ()
+{
+  long ip;
+
+  threadProc = NULL;
+  ThreadSync ();
+  for (ip = 1; ip < nThread; ip ++) pthread_join (pThread[ip], NULL);
+  free (pThread);
+  free (threadQueue);
+  free (threadBusy);
+  free (threadIdle);
+  free (threadWork);
+}
+
+void *ThreadWorker (void *tr)
+{
+  real t;
+
+  t = 0.;
+  while (1) {
+    ThreadSync ();
+    if (! threadProc) break;
+    if (threadStats) t = ThreadCpuTime ();
+    threadProc (tr);
+    if (threadStats) threadBusy[(long) tr] = ThreadCpuTime () - t;
+    ThreadSync ();
+  }
+  return (NULL);
+}
+
+/* with threadStats set, the processor time used by each thread in a
+   stage is recorded, and the time it would wait for the slowest thread
+   (were each thread on its own processor) is added to threadIdle */
+
+void RunThreads (void *(*tProc) (void *), int fStage)
+{
+  real t, tMax;
+  int iq;
+
+  threadProc = tProc;
+  funcStage = fStage;
+  t = 0.;
+  ThreadSync ();
+  if (threadStats) t = ThreadCpuTime ();
+  tProc ((void *) 0);
+  if (threadStats) threadBusy[0] = ThreadCpuTime () - t;
+  ThreadSync ();
+  if (threadStats) {
+    tMax = 0.;
+    THREAD_LOOP tMax = Max (tMax, threadBusy[iq]);
+    THREAD_LOOP {
+      threadWork[iq] += threadBusy[iq];
+      threadIdle[iq] += tMax - threadBusy[iq];
+    }
+  }
+}
+
+real ThreadCpuTime ()
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (ts.tv_sec + 1e-9 * ts.tv_nsec);
+}
+
+void PrintThreadStats (FILE *fp)
+{
+  real tIdle, tWork;
+  int iq;
+
+  tIdle = 0.;
+  tWork = 0.;
+  fprintf (fp, "thread   work (s)   idle (s)\n");
+  THREAD_LOOP {
+    fprintf (fp, "%6d %10.3f %10.3f\n", iq, threadWork[iq], threadIdle[iq]);
+    tIdle += threadIdle[iq];
+    tWork += threadWork[iq];
+  }
+  if (tWork > 0.) fprintf (fp, "efficiency %.3f\n", tWork / (tWork + tIdle));
+}
+
+/* divide n items into tasks of size items, assigned to the threads in
+   contiguous ranges; if threadSteal is zero the ranges are of equal
+   length, otherwise they are of equal cost, where the cost is taken
+   from taskTime (of length the number of tasks, initially zero) once
+   every task has been timed, and before that from costSum (if not
+   NULL), the cumulative cost of the items (of length n + 1); if
+   threadSteal is 2 a thread that has finished its own range takes
+   tasks from the ranges of the others; taskTime, if not NULL, receives
+   the measured task times (the split, and so the order in which
+   per-thread sums are formed, then varies from run to run) */
+
+void SetThreadTasks (int n, int size, int *costSum, real *taskTime)
+{
+  real tSum, tTot;
+  int iq, nTask, t;
+
+  threadTaskN = n;
+  threadTaskSize = size;
+  threadTaskTime = taskTime;
+  nTask = (n + size - 1) / size;
+  tTot = 0.;
+  if (taskTime) {
+    for (t = 0; t < nTask && taskTime[t] > 0.; t ++) tTot += taskTime[t];
+    if (t < nTask) tTot = 0.;
+  }
+  tSum = 0.;
+  t = 0;
+  THREAD_LOOP {
+    threadQueue[iq].next = t;
+    threadQueue[iq].last = -1;
+    if (iq == nThread - 1) t = nTask;
+    else if (! threadSteal || (! costSum && tTot == 0.))
+       t = (iq + 1) * nTask / nThread;
+    else if (tTot > 0.) {
+      while (t < nTask && tSum < tTot * (iq + 1.) / nThread)
+         tSum += taskTime[t ++];
+    } else {
+      while (t < nTask && costSum[t * size] - costSum[0] <
+         (costSum[n] - costSum[0]) * (iq + 1.) / nThread) ++ t;
+    }
+    threadQueue[iq].end = t;
+  }
+}
+
+/* when timing, the time since the previous fetch by this thread is
+   charged to the task it then fetched */
+
+int ThreadNextTask (int ip)
+{
+  ThreadQueue *q;
+  real tNow, *tt;
+  int k, t;
+
+  t = -1;
+  for (k = 0; k < ((threadSteal == 2) ? nThread : 1); k ++) {
+    q = &threadQueue[(ip + k) % nThread];
+    if (__atomic_load_n (&q->next, __ATOMIC_RELAXED) < q->end) {
+      t = __atomic_fetch_add (&q->next, 1, __ATOMIC_RELAXED);
+      if (t < q->end) break;
+      t = -1;
+    }
+  }
+  if (threadTaskTime) {
+    q = &threadQueue[ip];
+    tNow = ThreadCpuTime ();
+    if (q->last >= 0) {
+      tt = &threadTaskTime[q->last];
+      *tt = (*tt > 0.) ? *tt + THREAD_TASK_EMA * (tNow - q->tBeg - *tt) :
+         tNow - q->tBeg;
+    }
+    q->last = t;
+    q->tBeg = tNow;
+  }
+  return (t);
+}
+
+void ThreadFirstTouch (void *p, size_t size)
+{
+  threadTouchP = p;
+  threadTouchSize = size;
+  RunThreads (ThreadTouchT, 0);
+}
+
+void *ThreadTouchT (void *tr)
+{
+  size_t j, jBeg, jEnd;
+  int ip;
+
+  QUERY_THREAD ();
+  jBeg = ip * threadTouchSize / nThread;
+  jEnd = (ip + 1) * threadTouchSize / nThread;
+  for (j = jBeg; j < jEnd; j += 4096) threadTouchP[j] = 0;
+  return (NULL);
+}
+
+/* sense-reversing barrier for all nThread threads */
+
+void ThreadSync ()
+{
+  int sense, spin;
+
+  if (nThread == 1) return;
+  sense = __atomic_load_n (&syncSense, __ATOMIC_ACQUIRE);
+  if (__atomic_add_fetch (&syncCount, 1, __ATOMIC_ACQ_REL) == nThread) {
+    __atomic_store_n (&syncCount, 0, __ATOMIC_RELAXED);
+    __atomic_store_n (&syncSense, ! sense, __ATOMIC_RELEASE);
+  } else {
+    spin = 0;
+    while (__atomic_load_n (&syncSense, __ATOMIC_ACQUIRE) == sense) {
+      if (++ spin > threadSpin) sched_yield ();
+    }
+  }
+}
+
+
+void *ThreadNull (void *tr)
+{
+  return (NULL);
+}
+
+/* measure the cost of dispatching an empty stage nRep times, using the
+   persistent workers and using a fresh pthread_create/join per stage;
+   the pool is resized for each thread count up to nThread */
+
+void BenchThreads (int nRep)
+{
+  struct timeval tv1, tv2;
+  pthread_t *pSpawn;
+  real tPool, tSpawn;
+  long ip;
+  int n, nThreadMax, nt;
+
+  nThreadMax = nThread;
+  AllocMem (pSpawn, nThreadMax, pthread_t);
+  printf ("dispatch (us)\nthreads       pool  create/join\n");
+  for (nt = 1; nt <= nThreadMax; nt ++) {
+    StopThreads ();
+    nThread = nt;
+    InitThreads ();
+    gettimeofday (&tv1, NULL);
+    for (n = 0; n < nRep; n ++) RunThreads (ThreadNull, 0);
+    gettimeofday (&tv2, NULL);
+    tPool = 1e6 * (tv2.tv_sec - tv1.tv_sec) + tv2.tv_usec - tv1.tv_usec;
+    gettimeofday (&tv1, NULL);
+    for (n = 0; n < nRep; n ++) {
+      for (ip = 1; ip < nThread; ip ++)
+         pthread_create (&pSpawn[ip], NULL, ThreadNull, (void *) ip);
+      ThreadNull ((void *) 0);
+      for (ip = 1; ip < nThread; ip ++) pthread_join (pSpawn[ip], NULL);
+    }
+    gettimeofday (&tv2, NULL);
+    tSpawn = 1e6 * (tv2.tv_sec - tv1.tv_sec) + tv2.tv_usec - tv1.tv_usec;
+    printf ("%7d %10.3f %12.3f\n", nThread, tPool / nRep, tSpawn / nRep);
+  }
+  free (pSpawn);
+}
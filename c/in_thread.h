@@ -0,0 +1,63 @@
+
+#ifndef THREAD_DEFS
+
+#define THREAD_DEFS
+
+/* link with -lpthread */
+
+#include <pthread.h>
+#include <sched.h>
+
+/* the worker threads are created once and wait at a barrier for each
+   stage function to be dispatched; the barrier spins threadSpin times
+   before yielding the processor */
+
+#define QUERY_THREAD()  ip = (long) tr
+#define QUERY_STAGE  funcStage
+#define THREAD_PROC_LOOP(tProc, fStage)                     \
+   RunThreads (tProc, fStage)
+#define THREAD_SPLIT_LOOP(j, jMax)                          \
+   THREAD_SPLIT_RANGE (j, 0, jMax)
+#define THREAD_SPLIT_RANGE(j, jBeg, jEnd)                   \
+   for (j = (jBeg) + ip * ((jEnd) - (jBeg)) / nThread;      \
+      j < (jBeg) + (ip + 1) * ((jEnd) - (jBeg)) / nThread; j ++)
+#define THREAD_LOOP  for (iq = 0; iq < nThread; iq ++)
+#define THREAD_SYNC  ThreadSync ()
+
+/* tasks set up by SetThreadTasks are fetched by each thread from its
+   own range and, if work stealing is enabled, then from the ranges of
+   the others; THREAD_TASK_LOOP visits the items j of each task t; if
+   the tasks are given a time array, the processor time of each task is
+   measured and folded into it with weight THREAD_TASK_EMA, and the
+   ranges are later balanced by these times */
+
+#define THREAD_TASK_EMA  0.25
+
+#define THREAD_TASK_LOOP(t, j)                              \
+   while ((t = ThreadNextTask (ip)) >= 0)                   \
+      for (j = t * threadTaskSize; j < Min ((t + 1) *       \
+         threadTaskSize, threadTaskN); j ++)
+
+/* pages of a freshly allocated array are first written by the thread
+   whose THREAD_SPLIT_LOOP range covers them, so that the operating
+   system places each share in the memory local to that thread */
+
+#define THREAD_TOUCH(a, n)                                  \
+   ThreadFirstTouch (a, (n) * sizeof ((a)[0]))
+
+typedef struct {
+  real tBeg;
+  int next, end, last, pad[11];
+} ThreadQueue;
+
+pthread_t *pThread;
+void *(*threadProc) (void *);
+ThreadQueue *threadQueue;
+char *threadTouchP;
+size_t threadTouchSize;
+real *threadBusy, *threadIdle, *threadTaskTime, *threadWork;
+int funcStage, nThread, syncCount, syncSense, threadSpin, threadStats,
+   threadSteal, threadTaskN, threadTaskSize;
+
+#endif
+
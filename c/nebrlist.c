@@ -27,6 +27,11 @@
 
 
 #include "in_mddefs.h"
+#include "in_cellbin.h"
+#include "in_reorder.h"
+#include "in_nebrlist.h"
+#include "in_nebrasync.h"
+#include "in_pairforce.h"
 #include "in_debug.h"
 
 typedef struct {
@@ -40,26 +45,38 @@ real deltaT, density, rCut, temperature, timeNow, uSum, velMag, vvSum;
 Prop kinEnergy, totEnergy;
 int moreCycles, nMol, randSeed, stepAvg, stepCount, stepEquil, stepLimit;
 VecI cells;
-int *cellList;
-real dispHi, rNebrShell;
+real rNebrShell;
 int *nebrTab, nebrNow, nebrTabFac, nebrTabLen, nebrTabMax;
+int *nebrTabPtr;
 real virSum;
 Prop pressure;
 real kinEnInitSum;
-int stepInitlzTemp;
+int countEnergy, stepEnergy, stepInitlzTemp;
+char pairLaw[NAME_S_LEN];
+int pairTabSize;
 int profLevel;
 
 NameList nameList[] = {
+  NameI (cellDiv),
   NameR (deltaT),
   NameR (density),
   NameI (initUcell),
+  NameI (nebrAsync),
+  NameI (nebrClustSize),
+  NameI (nebrPack),
   NameI (nebrTabFac),
+  NameS (pairLaw),
+  NameI (pairTabSize),
   NameI (randSeed),
+  NameI (reorderCurve),
   NameR (rNebrShell),
   NameI (stepAvg),
+  NameI (stepEnergy),
   NameI (stepEquil),
   NameI (stepInitlzTemp),
   NameI (stepLimit),
+  NameI (stepReorder),
+  NameI (stepTuneShell),
   NameR (temperature),
 };
 
@@ -83,6 +100,9 @@ int main (int argc, char **argv)
     SingleStep ();
     if (stepCount >= stepLimit) moreCycles = 0;
   }
+  PrintNebrStats (stdout, stepCount);
+  if (nebrAsync) printf ("background builds used %d, discarded %d\n",
+     nebrAsyncSwap, nebrAsyncDiscard);
 }
 
 
@@ -96,27 +116,30 @@ void SingleStep ()
   if (profLevel == 2) printf("LeapfrogStep(1): %f\n", TimerStop(&tm));
 
   if (profLevel == 2) TimerStart(&tm);
-  ApplyBoundaryCond ();
-  if (profLevel == 2) printf("ApplyBoundaryCond: %f\n", TimerStop(&tm));
-  
-  if (profLevel == 2) TimerStart(&tm);
+  if (stepReorder > 0 && stepCount % stepReorder == 0) reorderNow = 1;
+  if (nebrAsync) {
+    if (FINISH_NEBR_ASYNC (mol, nMol, rNebrShell, nebrNow)) nebrNow = 0;
+    else if (! nebrNow && NEBR_ASYNC_STATE () == 0 && stepTuneShell == 0 &&
+       NEBR_DISP_OVER (NEBR_ASYNC_START * rNebrShell))
+       START_NEBR_ASYNC (mol, nMol, rCut + rNebrShell);
+  }
   if (nebrNow) {
     nebrNow = 0;
-    dispHi = 0.;
+    if (reorderNow || nebrClustSize > 0) ReorderMols ();
     BuildNebrList ();
   }
   if (profLevel == 2) printf("BuildNebrList: %f\n", TimerStop(&tm));
   
   if (profLevel == 2) TimerStart(&tm);
+  pairForceOnly = ! EnergyStep ();
   ComputeForces ();
   if (profLevel == 2) printf("ComputeForces: %f\n", TimerStop(&tm));
   
   if (profLevel == 2) TimerStart(&tm);
   LeapfrogStep (2);
-  if (profLevel == 2) printf("LeapfrogStep(1): %f\n", TimerStop(&tm));
+  if (profLevel == 2) printf("LeapfrogStep(2): %f\n", TimerStop(&tm));
   
   if (profLevel == 2) TimerStart(&tm);
-  LeapfrogStep (2);
   EvalProps ();
   if (stepCount < stepEquil) AdjustInitTemp ();
   AccumProps (1);
@@ -125,12 +148,14 @@ void SingleStep ()
     PrintSummary (stdout);
     AccumProps (0);
   }
+  TuneNebrShell ();
   if (profLevel == 2) printf("Stat: %f\n", TimerStop(&tm));
 }
 
 void SetupJob ()
 {
   AllocArrays ();
+  PrintPairTab (stdout);
   InitRand (randSeed);
   stepCount = 0;
   InitCoords ();
@@ -143,75 +168,53 @@ void SetupJob ()
 
 void SetParams ()
 {
-  rCut = pow (2., 1./6.);
+  rCut = SetPairLaw (pairLaw);
   VSCopy (region, 1. / pow (density, 1./3.), initUcell);
   nMol = VProd (initUcell);
   velMag = sqrt (NDIM * (1. - 1. / nMol) * temperature);
-  VSCopy (cells, 1. / (rCut + rNebrShell), region);
+  if (stepEnergy <= 0) stepEnergy = Max (stepAvg / 10, 1);
+  cellDiv = Max (cellDiv, 1);
+  VSCopy (cells, cellDiv / (rCut + rNebrShell), region);
   nebrTabMax = nebrTabFac * nMol;
+  nebrClustSize = Min (nebrClustSize, PAIR_CLUST_MAX);
+  /* the helper owns the cell arrays while it runs (see in_nebrasync.h),
+     so only the plain list force path may be used with it */
+  if (nebrClustSize > 0 || stepReorder > 0) nebrAsync = 0;
+  if (nebrAsync) {
+    rNebrShell += NEBR_ASYNC_SKIN;
+    nebrTuneSkin = NEBR_ASYNC_SKIN;
+  }
+  if (nebrClustSize > 0 || nebrAsync || stepReorder <= 0) nebrPack = 0;
 }
 
 void AllocArrays ()
 {
   AllocMem (mol, nMol, Mol);
-  AllocMem (cellList, VProd (cells) + nMol, int);
-  AllocMem (nebrTab, 2 * nebrTabMax, int);
+  AllocReorder ();
+  AllocCellBins (VProd (cells), nMol);
+  if (! nebrPack) AllocMem (nebrTab, nebrTabMax, int);
+  AllocMem (nebrTabPtr, nMol + 1, int);
+  AllocMem (nebrRefR, nMol, VecR);
+  if (nebrClustSize > 0) AllocNebrClusters (nMol);
+  if (nebrAsync) AllocNebrAsync (nMol);
+  AllocMemS (rS, nMol);
+  AllocMemS (raS, nMol);
+  BuildPairTab (pairTabSize);
 }
 
 void BuildNebrList ()
 {
   struct timeval tm;
-  VecR dr, invWid, rs, shift;
-  VecI cc, m1v, m2v, vOff[] = OFFSET_VALS;
-  real rrNebr;
-  int c, j1, j2, m1, m1x, m1y, m1z, m2, n, offset;
 
-  rrNebr = Sqr (rCut + rNebrShell);
-  VDiv (invWid, cells, region);
-  
+  if (nebrAsync && NEBR_ASYNC_STATE () != 0) ErrExit (ERR_NEBR_ASYNC_BUSY);
   if (profLevel == 3) TimerStart(&tm);
-  for (n = nMol; n < nMol + VProd (cells); n ++) cellList[n] = -1;
-  DO_MOL {
-    VSAdd (rs, mol[n].r, 0.5, region);
-    VMul (cc, rs, invWid);
-    c = VLinear (cc, cells) + nMol;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
-  }
+  BIN_CELLS (mol, nMol);
   if (profLevel == 3) printf("BuildNebrList:Set: %f\n", TimerStop(&tm));
   
-  nebrTabLen = 0;
-  
   if (profLevel == 3) TimerStart(&tm);
-  for (m1z = 0; m1z < cells.z; m1z ++) {
-    for (m1y = 0; m1y < cells.y; m1y ++) {
-      for (m1x = 0; m1x < cells.x; m1x ++) {
-        VSet (m1v, m1x, m1y, m1z);
-        m1 = VLinear (m1v, cells) + nMol;
-        for (offset = 0; offset < N_OFFSET; offset ++) {
-          VAdd (m2v, m1v, vOff[offset]);
-          VZero (shift);
-          VCellWrapAll ();
-          m2 = VLinear (m2v, cells) + nMol;
-          DO_CELL (j1, m1) {
-            DO_CELL (j2, m2) {
-              if (m1 != m2 || j2 < j1) {
-                VSub (dr, mol[j1].r, mol[j2].r);
-                VVSub (dr, shift);
-                if (VLenSq (dr) < rrNebr) {
-                  if (nebrTabLen >= nebrTabMax)
-                     ErrExit (ERR_TOO_MANY_NEBRS);
-                  nebrTab[2 * nebrTabLen] = j1;
-                  nebrTab[2 * nebrTabLen + 1] = j2;
-                  ++ nebrTabLen;
-                }
-              }
-            }
-          }
-        }
-      }
-    }
-  }
+  BUILD_NEBR_TAB (mol, nMol, rCut + rNebrShell);
+  SAVE_NEBR_REF (mol, nMol);
+  if (nebrClustSize > 0) BuildNebrClusters (nMol);
   if (profLevel == 3) printf("BuildNebrList:Iter: %f\n", TimerStop(&tm));
 }
 
@@ -219,54 +222,66 @@ void BuildNebrList ()
 
 void ComputeForces ()
 {
-  VecR dr;
-  real fcVal, rr, rrCut, rri, rri3, uVal;
-  int j1, j2, n;
-
-  rrCut = Sqr (rCut);
-  DO_MOL VZero (mol[n].ra);
-  uSum = 0.;
-  virSum = 0.;
-  for (n = 0; n < nebrTabLen; n ++) {
-    j1 = nebrTab[2 * n];
-    j2 = nebrTab[2 * n + 1];
-    VSub (dr, mol[j1].r, mol[j2].r);
-    VWrapAll (dr);
-    rr = VLenSq (dr);
-    if (rr < rrCut) {
-      rri = 1. / rr;
-      rri3 = Cube (rri);
-      fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
-      uVal = 4. * rri3 * (rri3 - 1.) + 1.;
-      VVSAdd (mol[j1].ra, fcVal, dr);
-      VVSAdd (mol[j2].ra, - fcVal, dr);
-      uSum += uVal;
-      virSum += fcVal * rr;
-    }
+  int c, j1;
+
+  GatherPairCoords (NULL);
+  if (nebrClustSize > 0) {
+    for (c = 0; c < nNebrClust; c ++)
+       PairClusterRow (0, c, nebrClustTab + nebrClustPtr[c],
+       nebrClustPtr[c + 1] - nebrClustPtr[c], nebrClustSize, nMol);
+  } else if (nebrPack) {
+    for (j1 = 0; j1 < nMol; j1 ++)
+       PairRowPacked (0, j1, nebrPackTab, nebrTabPtr[j1],
+       nebrTabPtr[j1 + 1]);
+  } else {
+    for (j1 = 0; j1 < nMol; j1 ++)
+       PairRow (0, j1, NULL, nebrTab + nebrTabPtr[j1], 0,
+       nebrTabPtr[j1 + 1] - nebrTabPtr[j1], 1);
   }
+  ScatterPairAccels (NULL);
+  uSum = pairUSum;
+  virSum = pairVirSum;
 }
 
 
+/* each part is a single pass over the particles: the first also
+   applies the periodic boundaries and tracks the displacements, the
+   second also accumulates the sums needed by EvalProps */
+
 void LeapfrogStep (int part)
 {
   int n;
 
   if (part == 1) {
+    NEBR_DISP_ZERO;
     DO_MOL {
       VVSAdd (mol[n].rv, 0.5 * deltaT, mol[n].ra);
       VVSAdd (mol[n].r, deltaT, mol[n].rv);
+      VWrapAll (mol[n].r);
+      NEBR_DISP_TRACK (mol[n].r, n);
     }
+    if (NEBR_DISP_OVER (rNebrShell)) nebrNow = 1;
   } else {
-    DO_MOL VVSAdd (mol[n].rv, 0.5 * deltaT, mol[n].ra);
+    VZero (vSum);
+    vvSum = 0.;
+    DO_MOL {
+      VVSAdd (mol[n].rv, 0.5 * deltaT, mol[n].ra);
+      VVAdd (vSum, mol[n].rv);
+      vvSum += VLenSq (mol[n].rv);
+    }
   }
 }
 
 
-void ApplyBoundaryCond ()
-{
-  int n;
+/* the pair energy and virial only feed the totEnergy and pressure
+   averages, so they are needed every stepEnergy steps (by default about
+   ten samples per averaging interval) and on the step that closes each
+   interval; the rescaling in AdjustInitTemp uses only the kinetic
+   energy, which LeapfrogStep evaluates on every step */
 
-  DO_MOL VWrapAll (mol[n].r);
+int EnergyStep ()
+{
+  return (stepCount % stepAvg == 0 || stepCount % stepEnergy == 0);
 }
 
 
@@ -330,20 +345,6 @@ void InitAccels ()
 
 void EvalProps ()
 {
-  real vv, vvMax;
-  int n;
-
-  VZero (vSum);
-  vvSum = 0.;
-  vvMax = 0.;
-  DO_MOL {
-    VVAdd (vSum, mol[n].rv);
-    vv = VLenSq (mol[n].rv);
-    vvSum += vv;
-    vvMax = Max (vvMax, vv);
-  }
-  dispHi += sqrt (vvMax) * deltaT;
-  if (dispHi > 0.5 * rNebrShell) nebrNow = 1;
   kinEnergy.val = 0.5 * vvSum / nMol;
   totEnergy.val = kinEnergy.val + uSum / nMol;
   pressure.val = density * (vvSum + virSum) / (nMol * NDIM);
@@ -356,14 +357,18 @@ void AccumProps (int icode)
     PropZero (totEnergy);
     PropZero (kinEnergy);
     PropZero (pressure);
+    countEnergy = 0;
   } else if (icode == 1) {
-    PropAccum (totEnergy);
+    if (! pairForceOnly) {
+      PropAccum (totEnergy);
+      PropAccum (pressure);
+      ++ countEnergy;
+    }
     PropAccum (kinEnergy);
-    PropAccum (pressure);
   } else if (icode == 2) {
-    PropAvg (totEnergy, stepAvg);
+    PropAvg (totEnergy, countEnergy);
     PropAvg (kinEnergy, stepAvg);
-    PropAvg (pressure, stepAvg);
+    PropAvg (pressure, countEnergy);
   }
 }
 
@@ -381,4 +386,9 @@ void PrintSummary (FILE *fp)
 #include "in_rand.c"
 #include "in_errexit.c"
 #include "in_namelist.c"
+#include "in_cellbin.c"
+#include "in_reorder.c"
+#include "in_nebrlist.c"
+#include "in_nebrasync.c"
+#include "in_pairforce.c"
 #include "in_debug.c"
@@ -27,9 +27,12 @@
 
 
 #include "in_mddefs.h"
+#include "in_cellbin.h"
+#include "in_nebrlist.h"
+#include "in_gearpc.h"
 
 typedef struct {
-  VecR r, rv, ra, ra1, ra2, ro, rvo;
+  VecR r, rv, ra;
 } Mol;
 
 Mol *mol;
@@ -39,15 +42,16 @@ real deltaT, density, rCut, temperature, timeNow, uSum, velMag, vvSum;
 Prop kinEnergy, totEnergy;
 int moreCycles, nMol, stepAvg, stepCount, stepEquil, stepLimit;
 VecI cells;
-int *cellList;
-real dispHi, rNebrShell;
+real rNebrShell;
 int *nebrTab, nebrNow, nebrTabFac, nebrTabLen, nebrTabMax;
+int *nebrTabPtr;
 real virSum;
 Prop pressure;
 real kinEnInitSum;
 int stepInitlzTemp;
 
 NameList nameList[] = {
+  NameI (cellDiv),
   NameR (deltaT),
   NameR (density),
   NameI (initUcell),
@@ -57,6 +61,7 @@ NameList nameList[] = {
   NameI (stepEquil),
   NameI (stepInitlzTemp),
   NameI (stepLimit),
+  NameI (stepTuneShell),
   NameR (temperature),
 };
 
@@ -72,6 +77,7 @@ int main (int argc, char **argv)
     SingleStep ();
     if (stepCount >= stepLimit) moreCycles = 0;
   }
+  PrintNebrStats (stdout, stepCount);
 }
 
 
@@ -79,15 +85,13 @@ void SingleStep ()
 {
   ++ stepCount;
   timeNow = stepCount * deltaT;
+  PredictorStep ();
   if (nebrNow) {
     nebrNow = 0;
-    dispHi = 0.;
     BuildNebrList ();
   }
-  PredictorStep ();
   ComputeForces ();
   CorrectorStep ();
-  ApplyBoundaryCond ();
   EvalProps ();
   if (stepCount < stepEquil) AdjustInitTemp ();
   AccumProps (1);
@@ -96,6 +100,7 @@ void SingleStep ()
     PrintSummary (stdout);
     AccumProps (0);
   }
+  TuneNebrShell ();
 }
 
 void SetupJob ()
@@ -116,71 +121,33 @@ void SetParams ()
   VSCopy (region, 1. / pow (density, 1./3.), initUcell);
   nMol = VProd (initUcell);
   velMag = sqrt (NDIM * (1. - 1. / nMol) * temperature);
-  VSCopy (cells, 1. / (rCut + rNebrShell), region);
+  cellDiv = Max (cellDiv, 1);
+  VSCopy (cells, cellDiv / (rCut + rNebrShell), region);
   nebrTabMax = nebrTabFac * nMol;
 }
 
 void AllocArrays ()
 {
   AllocMem (mol, nMol, Mol);
-  AllocMem (cellList, VProd (cells) + nMol, int);
-  AllocMem (nebrTab, 2 * nebrTabMax, int);
+  AllocGearPC (nMol);
+  AllocCellBins (VProd (cells), nMol);
+  AllocMem (nebrTab, nebrTabMax, int);
+  AllocMem (nebrTabPtr, nMol + 1, int);
+  AllocMem (nebrRefR, nMol, VecR);
 }
 
 
 void BuildNebrList ()
 {
-  VecR dr, invWid, rs, shift;
-  VecI cc, m1v, m2v, vOff[] = OFFSET_VALS;
-  real rrNebr;
-  int c, j1, j2, m1, m1x, m1y, m1z, m2, n, offset;
-
-  rrNebr = Sqr (rCut + rNebrShell);
-  VDiv (invWid, cells, region);
-  for (n = nMol; n < nMol + VProd (cells); n ++) cellList[n] = -1;
-  DO_MOL {
-    VSAdd (rs, mol[n].r, 0.5, region);
-    VMul (cc, rs, invWid);
-    c = VLinear (cc, cells) + nMol;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
-  }
-  nebrTabLen = 0;
-  for (m1z = 0; m1z < cells.z; m1z ++) {
-    for (m1y = 0; m1y < cells.y; m1y ++) {
-      for (m1x = 0; m1x < cells.x; m1x ++) {
-        VSet (m1v, m1x, m1y, m1z);
-        m1 = VLinear (m1v, cells) + nMol;
-        for (offset = 0; offset < N_OFFSET; offset ++) {
-          VAdd (m2v, m1v, vOff[offset]);
-          VZero (shift);
-          VCellWrapAll ();
-          m2 = VLinear (m2v, cells) + nMol;
-          DO_CELL (j1, m1) {
-            DO_CELL (j2, m2) {
-              if (m1 != m2 || j2 < j1) {
-                VSub (dr, mol[j1].r, mol[j2].r);
-                VVSub (dr, shift);
-                if (VLenSq (dr) < rrNebr) {
-                  if (nebrTabLen >= nebrTabMax)
-                     ErrExit (ERR_TOO_MANY_NEBRS);
-                  nebrTab[2 * nebrTabLen] = j1;
-                  nebrTab[2 * nebrTabLen + 1] = j2;
-                  ++ nebrTabLen;
-                }
-              }
-            }
-          }
-        }
-      }
-    }
-  }
+  BIN_CELLS (mol, nMol);
+  BUILD_NEBR_TAB (mol, nMol, rCut + rNebrShell);
+  SAVE_NEBR_REF (mol, nMol);
 }
 
 
 void ComputeForces ()
 {
-  VecR dr;
+  VecR dr, fi, ri;
   real fcVal, rr, rrCut, rri, rri3, uVal;
   int j1, j2, n;
 
@@ -188,93 +155,62 @@ void ComputeForces ()
   DO_MOL VZero (mol[n].ra);
   uSum = 0.;
   virSum = 0.;
-  for (n = 0; n < nebrTabLen; n ++) {
-    j1 = nebrTab[2 * n];
-    j2 = nebrTab[2 * n + 1];
-    VSub (dr, mol[j1].r, mol[j2].r);
-    VWrapAll (dr);
-    rr = VLenSq (dr);
-    if (rr < rrCut) {
-      rri = 1. / rr;
-      rri3 = Cube (rri);
-      fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
-      uVal = 4. * rri3 * (rri3 - 1.) + 1.;
-      VVSAdd (mol[j1].ra, fcVal, dr);
-      VVSAdd (mol[j2].ra, - fcVal, dr);
-      uSum += uVal;
-      virSum += fcVal * rr;
+  for (j1 = 0; j1 < nMol; j1 ++) {
+    ri = mol[j1].r;
+    VZero (fi);
+    for (n = nebrTabPtr[j1]; n < nebrTabPtr[j1 + 1]; n ++) {
+      j2 = nebrTab[n];
+      VSub (dr, ri, mol[j2].r);
+      VWrapAll (dr);
+      rr = VLenSq (dr);
+      if (rr < rrCut) {
+        rri = 1. / rr;
+        rri3 = Cube (rri);
+        fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
+        uVal = 4. * rri3 * (rri3 - 1.) + 1.;
+        VVSAdd (fi, fcVal, dr);
+        VVSAdd (mol[j2].ra, - fcVal, dr);
+        uSum += uVal;
+        virSum += fcVal * rr;
+      }
     }
+    VVAdd (mol[j1].ra, fi);
   }
 }
 
 
-#define PCR4(r, ro, v, a, a1, a2, t)                        \
-   r.t = ro.t + deltaT * v.t +                              \
-   wr * (cr[0] * a.t + cr[1] * a1.t + cr[2] * a2.t)
-#define PCV4(r, ro, v, a, a1, a2, t)                        \
-   v.t = (r.t - ro.t) / deltaT +                            \
-   wv * (cv[0] * a.t + cv[1] * a1.t + cv[2] * a2.t)
-
-#define PR(t)                                               \
-   PCR4 (mol[n].r, mol[n].r, mol[n].rv,                     \
-   mol[n].ra, mol[n].ra1, mol[n].ra2, t)
-#define PRV(t)                                              \
-   PCV4 (mol[n].r, mol[n].ro, mol[n].rv,                    \
-   mol[n].ra, mol[n].ra1, mol[n].ra2, t)
-#define CR(t)                                               \
-   PCR4 (mol[n].r, mol[n].ro, mol[n].rvo,                   \
-   mol[n].ra, mol[n].ra1, mol[n].ra2, t)
-#define CRV(t)                                              \
-   PCV4 (mol[n].r, mol[n].ro, mol[n].rv,                    \
-   mol[n].ra, mol[n].ra1, mol[n].ra2, t)
+/* the predictor also applies the periodic boundaries and tracks the
+   displacements, the corrector also applies the boundaries and
+   accumulates the sums needed by EvalProps */
 
 void PredictorStep ()
 {
-  real cr[] = {19.,-10.,3.}, cv[] = {27.,-22.,7.}, div = 24., wr, wv;
   int n;
 
-  wr = Sqr (deltaT) / div;
-  wv = deltaT / div;
+  NEBR_DISP_ZERO;
   DO_MOL {
-    mol[n].ro = mol[n].r;
-    mol[n].rvo = mol[n].rv;
-    PR (x);
-    PRV (x);
-    PR (y);
-    PRV (y);
-    PR (z);
-    PRV (z);
-    mol[n].ra2 = mol[n].ra1;
-    mol[n].ra1 = mol[n].ra;
+    PC_PREDICT (n);
+    VWrapAll (mol[n].r);
+    NEBR_DISP_TRACK (mol[n].r, n);
   }
+  if (NEBR_DISP_OVER (rNebrShell)) nebrNow = 1;
 }
 
 void CorrectorStep ()
 {
-  real cr[] = {3.,10.,-1.}, cv[] = {7.,6.,-1.}, div = 24., wr, wv;
   int n;
 
-  wr = Sqr (deltaT) / div;
-  wv = deltaT / div;
+  VZero (vSum);
+  vvSum = 0.;
   DO_MOL {
-    CR (x);
-    CRV (x);
-    CR (y);
-    CRV (y);
-    CR (z);
-    CRV (z);
+    PC_CORRECT (n);
+    VWrapAll (mol[n].r);
+    VVAdd (vSum, mol[n].rv);
+    vvSum += VLenSq (mol[n].rv);
   }
 }
 
 
-void ApplyBoundaryCond ()
-{
-  int n;
-
-  DO_MOL VWrapAll (mol[n].r);
-}
-
-
 void AdjustInitTemp ()
 {
   real vFac;
@@ -329,30 +265,12 @@ void InitAccels ()
 {
   int n;
 
-  DO_MOL {
-    VZero (mol[n].ra);
-    VZero (mol[n].ra1);
-    VZero (mol[n].ra2);
-  }
+  DO_MOL VZero (mol[n].ra);
 }
 
 
 void EvalProps ()
 {
-  real vv, vvMax;
-  int n;
-
-  VZero (vSum);
-  vvSum = 0.;
-  vvMax = 0.;
-  DO_MOL {
-    VVAdd (vSum, mol[n].rv);
-    vv = VLenSq (mol[n].rv);
-    vvSum += vv;
-    vvMax = Max (vvMax, vv);
-  }
-  dispHi += sqrt (vvMax) * deltaT;
-  if (dispHi > 0.5 * rNebrShell) nebrNow = 1;
   kinEnergy.val = 0.5 * vvSum / nMol;
   totEnergy.val = kinEnergy.val + uSum / nMol;
   pressure.val = density * (vvSum + virSum) / (nMol * NDIM);
@@ -390,4 +308,7 @@ void PrintSummary (FILE *fp)
 #include "in_rand.c"
 #include "in_errexit.c"
 #include "in_namelist.c"
+#include "in_cellbin.c"
+#include "in_nebrlist.c"
+#include "in_gearpc.c"
 
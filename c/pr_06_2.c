@@ -27,6 +27,7 @@
 
 
 #include "in_mddefs.h"
+#include "in_cellbin.h"
 
 typedef struct {
   VecR r, rv, ra;
@@ -39,7 +40,6 @@ real deltaT, density, rCut, temperature, timeNow, uSum, velMag, vvSum;
 Prop kinEnergy, totEnergy;
 int moreCycles, nMol, stepAvg, stepCount, stepEquil, stepLimit;
 VecI cells;
-int *cellList;
 real virSum;
 Prop pressure;
 
@@ -108,27 +108,19 @@ void SetParams ()
 void AllocArrays ()
 {
   AllocMem (mol, nMol, Mol);
-  AllocMem (cellList, VProd (cells) + nMol, int);
+  AllocCellBins (VProd (cells), nMol);
 }
 
 
 void ComputeForces ()
 {
-  VecR dr, invWid, rs, shift;
-  VecI cc, m1v, m2v, vOff[] = OFFSET_VALS;
+  VecR dr, shift;
+  VecI m1v, m2v, vOff[] = OFFSET_VALS;
   real fcVal, rr, rrCut, rri, rri3, uVal;
-  int c, j1, j2, m1, m1x, m1y, m1z, m2, n, offset;
+  int j1, j2, m1, m1x, m1y, m1z, m2, n, offset;
 
   rrCut = Sqr (rCut);
-  VDiv (invWid, cells, region);
-  for (n = nMol; n < nMol + VProd (cells); n ++) cellList[n] = -1;
-  DO_MOL {
-    VSAdd (rs, mol[n].r, 0.5, region);
-    VMul (cc, rs, invWid);
-    c = VLinear (cc, cells) + nMol;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
-  }
+  BIN_CELLS (mol, nMol);
   DO_MOL VZero (mol[n].ra);
   uSum = 0.;
   virSum = 0.;
@@ -136,12 +128,12 @@ void ComputeForces ()
     for (m1y = 0; m1y < cells.y; m1y ++) {
       for (m1x = 0; m1x < cells.x; m1x ++) {
         VSet (m1v, m1x, m1y, m1z);
-        m1 = VLinear (m1v, cells) + nMol;
+        m1 = VLinear (m1v, cells);
         for (offset = 0; offset < N_OFFSET; offset ++) {
           VAdd (m2v, m1v, vOff[offset]);
           VZero (shift);
           VCellWrapAll ();
-          m2 = VLinear (m2v, cells) + nMol;
+          m2 = VLinear (m2v, cells);
           DO_CELL (j1, m1) {
             DO_CELL (j2, m2) {
               if (m1 != m2 || j2 < j1) {
@@ -310,4 +302,5 @@ void PrintSummary (FILE *fp)
 #include "in_rand.c"
 #include "in_errexit.c"
 #include "in_namelist.c"
+#include "in_cellbin.c"
 
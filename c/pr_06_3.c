@@ -27,6 +27,7 @@
 
 
 #include "in_mddefs.h"
+#include "in_cellbin.h"
 
 typedef struct {
   VecR r, rv, ra, ra1, ra2, ro, rvo;
@@ -39,7 +40,6 @@ real deltaT, density, rCut, temperature, timeNow, uSum, velMag, vvSum;
 Prop kinEnergy, totEnergy;
 int moreCycles, nMol, stepAvg, stepCount, stepEquil, stepLimit;
 VecI cells;
-int *cellList;
 real virSum;
 Prop pressure;
 real dilateRate, dilateRate1, dilateRate2, dvirSum1, dvirSum2,
@@ -127,7 +127,7 @@ void SetParams ()
 void AllocArrays ()
 {
   AllocMem (mol, nMol, Mol);
-  AllocMem (cellList, Cube (maxEdgeCells) + nMol, int);
+  AllocCellBins (Cube (maxEdgeCells), nMol);
 }
 
 void PrintSummary (FILE *fp)
@@ -144,23 +144,15 @@ void PrintSummary (FILE *fp)
 
 void ComputeForces ()
 {
-  VecR dr, invWid, rs, shift;
-  VecI cc, m1v, m2v, vOff[] = OFFSET_VALS;
+  VecR dr, shift;
+  VecI m1v, m2v, vOff[] = OFFSET_VALS;
   real fcVal, rr, rrCut, rri, rri3, uVal;
   VecR dv;
   real w;
-  int c, j1, j2, m1, m1x, m1y, m1z, m2, n, offset;
+  int j1, j2, m1, m1x, m1y, m1z, m2, n, offset;
 
   rrCut = Sqr (rCut);
-  VDiv (invWid, cells, region);
-  for (n = nMol; n < nMol + VProd (cells); n ++) cellList[n] = -1;
-  DO_MOL {
-    VSAdd (rs, mol[n].r, 0.5, region);
-    VMul (cc, rs, invWid);
-    c = VLinear (cc, cells) + nMol;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
-  }
+  BIN_CELLS (mol, nMol);
   DO_MOL VZero (mol[n].ra);
   uSum = 0.;
   virSum = 0.;
@@ -169,12 +161,12 @@ void ComputeForces ()
     for (m1y = 0; m1y < cells.y; m1y ++) {
       for (m1x = 0; m1x < cells.x; m1x ++) {
         VSet (m1v, m1x, m1y, m1z);
-        m1 = VLinear (m1v, cells) + nMol;
+        m1 = VLinear (m1v, cells);
         for (offset = 0; offset < N_OFFSET; offset ++) {
           VAdd (m2v, m1v, vOff[offset]);
           VZero (shift);
           VCellWrapAll ();
-          m2 = VLinear (m2v, cells) + nMol;
+          m2 = VLinear (m2v, cells);
           DO_CELL (j1, m1) {
             DO_CELL (j2, m2) {
               if (m1 != m2 || j2 < j1) {
@@ -510,4 +502,5 @@ void AccumProps (int icode)
 #include "in_rand.c"
 #include "in_errexit.c"
 #include "in_namelist.c"
+#include "in_cellbin.c"
 
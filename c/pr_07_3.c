@@ -27,6 +27,7 @@
 
 
 #include "in_mddefs.h"
+#include "in_cellbin.h"
 
 typedef struct {
   VecR r, rv, ra, ra1, ra2, ro, rvo;
@@ -39,7 +40,6 @@ real deltaT, density, rCut, temperature, timeNow, uSum, velMag, vvSum;
 Prop kinEnergy, totEnergy;
 int moreCycles, nMol, stepAvg, stepCount, stepEquil, stepLimit;
 VecI cells;
-int *cellList;
 int stepAdjustTemp;
 real bdySlide, pTensorXZ, shearRate, vvSumXZ;
 Prop shearVisc;
@@ -115,7 +115,7 @@ void SetParams ()
 void AllocArrays ()
 {
   AllocMem (mol, nMol, Mol);
-  AllocMem (cellList, VProd (cells) + nMol, int);
+  AllocCellBins (VProd (cells), nMol);
 }
 
 void PrintSummary (FILE *fp)
@@ -140,22 +140,14 @@ void PrintSummary (FILE *fp)
 
 void ComputeForces ()
 {
-  VecR dr, invWid, rs, shift;
-  VecI cc, m1v, m2v, vOff[] = OFFSET_VALS;
+  VecR dr, shift;
+  VecI m1v, m2v, vOff[] = OFFSET_VALS;
   real fcVal, rr, rrCut, rri, rri3, uVal;
-  int c, j1, j2, m1, m1x, m1y, m1z, m2, n, offset;
+  int j1, j2, m1, m1x, m1y, m1z, m2, n, offset;
   int cellShiftX, offsetHi;
 
   rrCut = Sqr (rCut);
-  VDiv (invWid, cells, region);
-  for (n = nMol; n < nMol + VProd (cells); n ++) cellList[n] = -1;
-  DO_MOL {
-    VSAdd (rs, mol[n].r, 0.5, region);
-    VMul (cc, rs, invWid);
-    c = VLinear (cc, cells) + nMol;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
-  }
+  BIN_CELLS (mol, nMol);
   DO_MOL VZero (mol[n].ra);
   uSum = 0.;
   cellShiftX = (int) (cells.x * (1. - bdySlide / region.x)) - cells.x;
@@ -164,7 +156,7 @@ void ComputeForces ()
     for (m1y = 0; m1y < cells.y; m1y ++) {
       for (m1x = 0; m1x < cells.x; m1x ++) {
         VSet (m1v, m1x, m1y, m1z);
-        m1 = VLinear (m1v, cells) + nMol;
+        m1 = VLinear (m1v, cells);
         offsetHi = (m1v.z == cells.z - 1) ? 17 : 14;
         for (offset = 0; offset < offsetHi; offset ++) {
           VAdd (m2v, m1v, vOff[offset]);
@@ -184,7 +176,7 @@ void ComputeForces ()
           }
           VCellWrap (y);
           VCellWrap (z);
-          m2 = VLinear (m2v, cells) + nMol;
+          m2 = VLinear (m2v, cells);
           DO_CELL (j1, m1) {
             DO_CELL (j2, m2) {
               if (m1 != m2 || j2 < j1) {
@@ -429,4 +421,5 @@ void AccumProps (int icode)
 #include "in_rand.c"
 #include "in_errexit.c"
 #include "in_namelist.c"
+#include "in_cellbin.c"
 
@@ -27,6 +27,8 @@
 
 
 #include "in_mddefs.h"
+#include "in_cellbin.h"
+#include "in_nebrlist.h"
 
 typedef struct {
   VecR r, rv, ra, ra1, ra2, ro, rvo, rf[3];
@@ -40,9 +42,9 @@ real deltaT, density, rCut, temperature, timeNow, uSum, velMag, vvSum;
 Prop kinEnergy, totEnergy;
 int moreCycles, nMol, stepAvg, stepCount, stepEquil, stepLimit;
 VecI cells;
-int *cellList;
-real dispHi, rNebrShell;
+real rNebrShell;
 int *nebrTab, nebrNow, nebrTabFac, nebrTabLen, nebrTabMax;
+int *nebrTabPtr;
 real heatForce;
 Prop thermalCond;
 
@@ -71,6 +73,7 @@ int main (int argc, char **argv)
     SingleStep ();
     if (stepCount >= stepLimit) moreCycles = 0;
   }
+  PrintNebrStats (stdout, stepCount);
 }
 
 
@@ -78,13 +81,12 @@ void SingleStep ()
 {
   ++ stepCount;
   timeNow = stepCount * deltaT;
+  PredictorStep ();
+  ApplyBoundaryCond ();
   if (nebrNow) {
     nebrNow = 0;
-    dispHi = 0.;
     BuildNebrList ();
   }
-  PredictorStep ();
-  ApplyBoundaryCond ();
   ComputeForces ();
   ComputeThermalForce ();
   ApplyThermostat ();
@@ -123,8 +125,10 @@ void SetParams ()
 void AllocArrays ()
 {
   AllocMem (mol, nMol, Mol);
-  AllocMem (cellList, VProd (cells) + nMol, int);
-  AllocMem (nebrTab, 2 * nebrTabMax, int);
+  AllocCellBins (VProd (cells), nMol);
+  AllocMem (nebrTab, nebrTabMax, int);
+  AllocMem (nebrTabPtr, nMol + 1, int);
+  AllocMem (nebrRefR, nMol, VecR);
 }
 
 void PrintSummary (FILE *fp)
@@ -141,51 +145,9 @@ void PrintSummary (FILE *fp)
 
 void BuildNebrList ()
 {
-  VecR dr, invWid, rs, shift;
-  VecI cc, m1v, m2v, vOff[] = OFFSET_VALS;
-  real rrNebr;
-  int c, j1, j2, m1, m1x, m1y, m1z, m2, n, offset;
-
-  rrNebr = Sqr (rCut + rNebrShell);
-  VDiv (invWid, cells, region);
-  for (n = nMol; n < nMol + VProd (cells); n ++) cellList[n] = -1;
-  DO_MOL {
-    VSAdd (rs, mol[n].r, 0.5, region);
-    VMul (cc, rs, invWid);
-    c = VLinear (cc, cells) + nMol;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
-  }
-  nebrTabLen = 0;
-  for (m1z = 0; m1z < cells.z; m1z ++) {
-    for (m1y = 0; m1y < cells.y; m1y ++) {
-      for (m1x = 0; m1x < cells.x; m1x ++) {
-        VSet (m1v, m1x, m1y, m1z);
-        m1 = VLinear (m1v, cells) + nMol;
-        for (offset = 0; offset < N_OFFSET; offset ++) {
-          VAdd (m2v, m1v, vOff[offset]);
-          VZero (shift);
-          VCellWrapAll ();
-          m2 = VLinear (m2v, cells) + nMol;
-          DO_CELL (j1, m1) {
-            DO_CELL (j2, m2) {
-              if (m1 != m2 || j2 < j1) {
-                VSub (dr, mol[j1].r, mol[j2].r);
-                VVSub (dr, shift);
-                if (VLenSq (dr) < rrNebr) {
-                  if (nebrTabLen >= nebrTabMax)
-                     ErrExit (ERR_TOO_MANY_NEBRS);
-                  nebrTab[2 * nebrTabLen] = j1;
-                  nebrTab[2 * nebrTabLen + 1] = j2;
-                  ++ nebrTabLen;
-                }
-              }
-            }
-          }
-        }
-      }
-    }
-  }
+  BIN_CELLS (mol, nMol);
+  BUILD_NEBR_TAB (mol, nMol, rCut + rNebrShell);
+  SAVE_NEBR_REF (mol, nMol);
 }
 
 
@@ -203,29 +165,30 @@ void ComputeForces ()
     mol[n].en = 0.;
     for (k = 0; k < 3; k ++) VZero (mol[n].rf[k]);
   }
-  for (n = 0; n < nebrTabLen; n ++) {
-    j1 = nebrTab[2 * n];
-    j2 = nebrTab[2 * n + 1];
-    VSub (dr, mol[j1].r, mol[j2].r);
-    VWrapAll (dr);
-    rr = VLenSq (dr);
-    if (rr < rrCut) {
-      rri = 1. / rr;
-      rri3 = Cube (rri);
-      fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
-      uVal = 4. * rri3 * (rri3 - 1.) + 1.;
-      VVSAdd (mol[j1].ra, fcVal, dr);
-      VVSAdd (mol[j2].ra, - fcVal, dr);
-      uSum += uVal;
-      mol[j1].en += uVal;
-      mol[j2].en += uVal;
-      for (k = 0; k < 3; k ++) w[k] = dr;
-      VScale (w[0], fcVal * dr.x);
-      VScale (w[1], fcVal * dr.y);
-      VScale (w[2], fcVal * dr.z);
-      for (k = 0; k < 3; k ++) {
-        VVAdd (mol[j1].rf[k], w[k]);
-        VVAdd (mol[j2].rf[k], w[k]);
+  for (j1 = 0; j1 < nMol; j1 ++) {
+    for (n = nebrTabPtr[j1]; n < nebrTabPtr[j1 + 1]; n ++) {
+      j2 = nebrTab[n];
+      VSub (dr, mol[j1].r, mol[j2].r);
+      VWrapAll (dr);
+      rr = VLenSq (dr);
+      if (rr < rrCut) {
+        rri = 1. / rr;
+        rri3 = Cube (rri);
+        fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
+        uVal = 4. * rri3 * (rri3 - 1.) + 1.;
+        VVSAdd (mol[j1].ra, fcVal, dr);
+        VVSAdd (mol[j2].ra, - fcVal, dr);
+        uSum += uVal;
+        mol[j1].en += uVal;
+        mol[j2].en += uVal;
+        for (k = 0; k < 3; k ++) w[k] = dr;
+        VScale (w[0], fcVal * dr.x);
+        VScale (w[1], fcVal * dr.y);
+        VScale (w[2], fcVal * dr.z);
+        for (k = 0; k < 3; k ++) {
+          VVAdd (mol[j1].rf[k], w[k]);
+          VVAdd (mol[j2].rf[k], w[k]);
+        }
       }
     }
   }
@@ -283,6 +246,7 @@ void PredictorStep ()
 
   wr = Sqr (deltaT) / div;
   wv = deltaT / div;
+  NEBR_DISP_ZERO;
   DO_MOL {
     mol[n].ro = mol[n].r;
     mol[n].rvo = mol[n].rv;
@@ -294,7 +258,9 @@ void PredictorStep ()
     PRV (z);
     mol[n].ra2 = mol[n].ra1;
     mol[n].ra1 = mol[n].ra;
+    NEBR_DISP_TRACK (mol[n].r, n);
   }
+  if (NEBR_DISP_OVER (rNebrShell)) nebrNow = 1;
 }
 
 void CorrectorStep ()
@@ -394,21 +360,17 @@ void InitAccels ()
 
 void EvalProps ()
 {
-  real vv, vvMax;
+  real vv;
   int n;
   real thermVecZ;
 
   VZero (vSum);
   vvSum = 0.;
-  vvMax = 0.;
   DO_MOL {
     VVAdd (vSum, mol[n].rv);
     vv = VLenSq (mol[n].rv);
     vvSum += vv;
-    vvMax = Max (vvMax, vv);
   }
-  dispHi += sqrt (vvMax) * deltaT;
-  if (dispHi > 0.5 * rNebrShell) nebrNow = 1;
   kinEnergy.val = 0.5 * vvSum / nMol;
   totEnergy.val = kinEnergy.val + uSum / nMol;
   thermVecZ = 0.;
@@ -438,4 +400,6 @@ void AccumProps (int icode)
 #include "in_rand.c"
 #include "in_errexit.c"
 #include "in_namelist.c"
+#include "in_cellbin.c"
+#include "in_nebrlist.c"
 
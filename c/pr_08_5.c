@@ -27,6 +27,8 @@
 
 
 #include "in_mddefs.h"
+#include "in_cellbin.h"
+#include "in_nebrlist.h"
 
 typedef struct {
   VecR r, rv, ra;
@@ -49,9 +51,9 @@ real deltaT, density, rCut, temperature, timeNow, uSum, velMag, vvSum;
 Prop kinEnergy, totEnergy;
 int moreCycles, nMol, stepAvg, stepCount, stepEquil, stepLimit;
 VecI cells;
-int *cellList;
 real dispHi, rNebrShell;
 int *nebrTab, nebrNow, nebrTabFac, nebrTabLen, nebrTabMax;
+int *nebrTabPtr;
 VecR mInert;
 real siteSep, farSiteDist;
 int sitesMol, nSite;
@@ -146,8 +148,9 @@ void AllocArrays ()
   AllocMem (mol, nMol, Mol);
   AllocMem (site, nSite, Site);
   AllocMem (mSite, sitesMol, MSite);
-  AllocMem (cellList, VProd (cells) + nSite, int);
-  AllocMem (nebrTab, 2 * nebrTabMax, int);
+  AllocCellBins (VProd (cells), nSite);
+  AllocMem (nebrTab, nebrTabMax, int);
+  AllocMem (nebrTabPtr, nSite + 1, int);
 }
 
 
@@ -203,79 +206,46 @@ void BuildStepRmatT (RMat *mp, VecR *a)
 }
 
 
+#define NEBR_CELL_WRAP                                     \
+   if (m2v.x < 0 || m2v.x >= cells.x ||                    \
+       m2v.y < 0 || m2v.y >= cells.y ||                    \
+                    m2v.z >= cells.z) continue
+#define NEBR_PAIR_OK(j1, j2)  ((j1) / sitesMol != (j2) / sitesMol)
+
 void BuildNebrList ()
 {
-  VecR dr, invWid, rs;
-  VecI cc, m1v, m2v, vOff[] = OFFSET_VALS;
-  real rrNebr;
-  int c, j1, j2, m1, m1x, m1y, m1z, m2, n, offset;
-
-  rrNebr = Sqr (rCut + rNebrShell);
-  VDiv (invWid, cells, region);
-  for (n = nSite; n < nSite + VProd (cells); n ++) cellList[n] = -1;
-  for (n = 0; n < nSite; n ++) {
-    VSAdd (rs, site[n].r, 0.5, region);
-    VMul (cc, rs, invWid);
-    c = VLinear (cc, cells) + nSite;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
-  }
-  nebrTabLen = 0;
-  for (m1z = 0; m1z < cells.z; m1z ++) {
-    for (m1y = 0; m1y < cells.y; m1y ++) {
-      for (m1x = 0; m1x < cells.x; m1x ++) {
-        VSet (m1v, m1x, m1y, m1z);
-        m1 = VLinear (m1v, cells) + nSite;
-        for (offset = 0; offset < N_OFFSET; offset ++) {
-          VAdd (m2v, m1v, vOff[offset]);
-          if (m2v.x < 0 || m2v.x >= cells.x ||
-              m2v.y < 0 || m2v.y >= cells.y ||
-                           m2v.z >= cells.z) continue;
-          m2 = VLinear (m2v, cells) + nSite;
-          DO_CELL (j1, m1) {
-            DO_CELL (j2, m2) {
-              if ((m1 != m2 || j2 < j1) && j1 / sitesMol != j2 / sitesMol) {
-                VSub (dr, site[j1].r, site[j2].r);
-                if (VLenSq (dr) < rrNebr) {
-                  if (nebrTabLen >= nebrTabMax)
-                     ErrExit (ERR_TOO_MANY_NEBRS);
-                  nebrTab[2 * nebrTabLen] = j1;
-                  nebrTab[2 * nebrTabLen + 1] = j2;
-                  ++ nebrTabLen;
-                }
-              }
-            }
-          }
-        }
-      }
-    }
-  }
+  BIN_CELLS (site, nSite);
+  BUILD_NEBR_TAB (site, nSite, rCut + rNebrShell);
 }
 
 
 void ComputeSiteForces ()
 {
-  VecR dr;
+  VecR dr, fi, ri;
   real fcVal, rr, rrCut, rri, rri3, uVal;
   int j1, j2, n;
 
   rrCut = Sqr (rCut);
   for (n = 0; n < nSite; n ++) VZero (site[n].f);
   uSum = 0.;
-  for (n = 0; n < nebrTabLen; n ++) {
-    j1 = nebrTab[2 * n];
-    j2 = nebrTab[2 * n + 1];
-    VSub (dr, site[j1].r, site[j2].r);
-    rr = VLenSq (dr);
-    if (rr < rrCut) {
-      rri = 1. / rr;
-      rri3 = Cube (rri);
-      fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
-      uVal = 4. * rri3 * (rri3 - 1.) + 1.;
-      VVSAdd (site[j1].f, fcVal, dr);
-      VVSAdd (site[j2].f, - fcVal, dr);
-      uSum += uVal;
+  for (j1 = 0; j1 < nSite; j1 ++) {
+    ri = site[j1].r;
+    VZero (fi);
+    for (n = nebrTabPtr[j1]; n < nebrTabPtr[j1 + 1]; n ++) {
+      j2 = nebrTab[n];
+      VSub (dr, ri, site[j2].r);
+      rr = VLenSq (dr);
+      if (rr < rrCut) {
+        rri = 1. / rr;
+        rri3 = Cube (rri);
+        fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
+        uVal = 4. * rri3 * (rri3 - 1.) + 1.;
+        VVSAdd (fi, fcVal, dr);
+        VVSAdd (site[j2].f, - fcVal, dr);
+        uSum += uVal;
+      }
     }
+    VVAdd (site[j1].f, fi);
   }
 }
 
@@ -621,4 +591,6 @@ void PrintSummary (FILE *fp)
 #include "in_rand.c"
 #include "in_errexit.c"
 #include "in_namelist.c"
+#include "in_cellbin.c"
+#include "in_nebrlist.c"
 
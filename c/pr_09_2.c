@@ -27,6 +27,7 @@
 
 
 #include "in_mddefs.h"
+#include "in_cellbin.h"
 
 typedef struct {
   VecR r, rv, ra;
@@ -44,9 +45,9 @@ real deltaT, density, rCut, temperature, timeNow, uSum, velMag, vvSum;
 Prop kinEnergy, totEnergy;
 int moreCycles, nMol, runId, stepAvg, stepCount, stepLimit;
 VecI cells;
-int *cellList;
 real dispHi, rNebrShell;
 int *nebrTab, nebrNow, nebrTabFac, nebrTabLen, nebrTabMax;
+int *nebrTabPtr;
 int stepAdjustTemp;
 real bondLim, rCutA, solConc;
 int *intType, chainHead, chainLen, nChain;
@@ -161,74 +162,63 @@ void SetParams ()
 void AllocArrays ()
 {
   AllocMem (mol, nMol, Mol);
-  AllocMem (cellList, VProd (cells) + nMol, int);
-  AllocMem (nebrTab, 2 * nebrTabMax, int);
+  AllocCellBins (VProd (cells), nMol);
+  AllocMem (nebrTab, nebrTabMax, int);
+  AllocMem (nebrTabPtr, nMol + 1, int);
   AllocMem (intType, nebrTabMax, int);
   AllocMem (clust, nMol, Clust);
 }
 
 void BuildNebrList ()
 {
-  VecR dr, invWid, rs, shift;
-  VecI cc, m1v, m2v, vOff[] = OFFSET_VALS;
+  VecR dr, ri, shift;
+  VecI m1v, m2v, vOff[] = OFFSET_VALS;
   real rrNebr, rrNebrA;
-  int c, iType, j1, j2, m1, m1x, m1y, m1z, m2, n, offset, sameChain;
+  int iType, j1, j2, m1, m2, offset, sameChain;
 
   rrNebr = Sqr (rCut + rNebrShell);
   rrNebrA = Sqr (rCutA + rNebrShell);
-  VDiv (invWid, cells, region);
-  for (n = nMol; n < nMol + VProd (cells); n ++) cellList[n] = -1;
-  DO_MOL {
-    VSAdd (rs, mol[n].r, 0.5, region);
-    VMul (cc, rs, invWid);
-    c = VLinear (cc, cells) + nMol;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
-  }
+  BIN_CELLS (mol, nMol);
   nebrTabLen = 0;
-  for (m1z = 0; m1z < cells.z; m1z ++) {
-    for (m1y = 0; m1y < cells.y; m1y ++) {
-      for (m1x = 0; m1x < cells.x; m1x ++) {
-        VSet (m1v, m1x, m1y, m1z);
-        m1 = VLinear (m1v, cells) + nMol;
-        for (offset = 0; offset < N_OFFSET; offset ++) {
-          VAdd (m2v, m1v, vOff[offset]);
-          VZero (shift);
-          VCellWrapAll ();
-          m2 = VLinear (m2v, cells) + nMol;
-          DO_CELL (j1, m1) {
-            DO_CELL (j2, m2) {
-              if (m1 != m2 || j2 < j1) {
-                VSub (dr, mol[j1].r, mol[j2].r);
-                VVSub (dr, shift);
-                sameChain = (mol[j1].inChain == mol[j2].inChain &&
-                   mol[j1].inChain >= 0);
-                iType = 0;
-                if (mol[j1].typeA == mol[j2].typeA && ! sameChain) {
-                  if (VLenSq (dr) < rrNebrA) iType = 2;
-                } else if (! sameChain || abs (j1 - j2) > 1) {
-                  if (VLenSq (dr) < rrNebr) iType = 1;
-                }
-                if (iType > 0) {
-                  if (nebrTabLen >= nebrTabMax)
-                     ErrExit (ERR_TOO_MANY_NEBRS);
-                  nebrTab[2 * nebrTabLen] = j1;
-                  nebrTab[2 * nebrTabLen + 1] = j2;
-                  intType[nebrTabLen] = iType;
-                  ++ nebrTabLen;
-                }
-              }
-            }
+  for (j1 = 0; j1 < nMol; j1 ++) {
+    nebrTabPtr[j1] = nebrTabLen;
+    ri = mol[j1].r;
+    m1 = cellOf[j1];
+    VCellVec (m1v, m1);
+    for (offset = 0; offset < N_OFFSET; offset ++) {
+      VAdd (m2v, m1v, vOff[offset]);
+      VZero (shift);
+      VCellWrapAll ();
+      m2 = VLinear (m2v, cells);
+      DO_CELL (j2, m2) {
+        if (m1 != m2 || j2 < j1) {
+          VSub (dr, ri, mol[j2].r);
+          VVSub (dr, shift);
+          sameChain = (mol[j1].inChain == mol[j2].inChain &&
+             mol[j1].inChain >= 0);
+          iType = 0;
+          if (mol[j1].typeA == mol[j2].typeA && ! sameChain) {
+            if (VLenSq (dr) < rrNebrA) iType = 2;
+          } else if (! sameChain || abs (j1 - j2) > 1) {
+            if (VLenSq (dr) < rrNebr) iType = 1;
+          }
+          if (iType > 0) {
+            if (nebrTabLen >= nebrTabMax)
+               ErrExit (ERR_TOO_MANY_NEBRS);
+            nebrTab[nebrTabLen] = j2;
+            intType[nebrTabLen] = iType;
+            ++ nebrTabLen;
           }
         }
       }
     }
   }
+  nebrTabPtr[nMol] = nebrTabLen;
 }
 
 void ComputeForces ()
 {
-  VecR dr;
+  VecR dr, fi, ri;
   real fcVal, rr, rrCut, rrCutA, rri, rri3, uVal;
   int j1, j2, n;
 
@@ -236,22 +226,26 @@ void ComputeForces ()
   uSum = 0.;
   rrCut = Sqr (rCut);
   rrCutA = Sqr (rCutA);
-  for (n = 0; n < nebrTabLen; n ++) {
-    j1 = nebrTab[2 * n];
-    j2 = nebrTab[2 * n + 1];
-    VSub (dr, mol[j1].r, mol[j2].r);
-    VWrapAll (dr);
-    rr = VLenSq (dr);
-    if (rr < rrCut || intType[n] == 2 && rr < rrCutA) {
-      rri = 1. / rr;
-      rri3 = Cube (rri);
-      fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
-      uVal = 4. * rri3 * (rri3 - 1.);
-      if (intType[n] == 1) uVal += 1.;
-      VVSAdd (mol[j1].ra, fcVal, dr);
-      VVSAdd (mol[j2].ra, - fcVal, dr);
-      uSum += uVal;
+  for (j1 = 0; j1 < nMol; j1 ++) {
+    ri = mol[j1].r;
+    VZero (fi);
+    for (n = nebrTabPtr[j1]; n < nebrTabPtr[j1 + 1]; n ++) {
+      j2 = nebrTab[n];
+      VSub (dr, ri, mol[j2].r);
+      VWrapAll (dr);
+      rr = VLenSq (dr);
+      if (rr < rrCut || intType[n] == 2 && rr < rrCutA) {
+        rri = 1. / rr;
+        rri3 = Cube (rri);
+        fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
+        uVal = 4. * rri3 * (rri3 - 1.);
+        if (intType[n] == 1) uVal += 1.;
+        VVSAdd (fi, fcVal, dr);
+        VVSAdd (mol[j2].ra, - fcVal, dr);
+        uSum += uVal;
+      }
     }
+    VVAdd (mol[j1].ra, fi);
   }
 }
 
@@ -463,31 +457,23 @@ void AccumProps (int icode)
 
 void BuildClusters ()
 {
-  VecR dr, invWid, rs, shift;
-  VecI cc, m1v, m2v, vOff[] = OFFSET_VALS;
+  VecR dr, shift;
+  VecI m1v, m2v, vOff[] = OFFSET_VALS;
   real rrClust;
-  int c, j1, j2, m1, m1x, m1y, m1z, m2, n, offset;
+  int j1, j2, m1, m1x, m1y, m1z, m2, offset;
 
   rrClust = Sqr (rClust);
-  VDiv (invWid, cells, region);
-  for (n = nMol; n < nMol + VProd (cells); n ++) cellList[n] = -1;
-  DO_MOL {
-    VSAdd (rs, mol[n].r, 0.5, region);
-    VMul (cc, rs, invWid);
-    c = VLinear (cc, cells) + nMol;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
-  }
+  BIN_CELLS (mol, nMol);
   for (m1z = 0; m1z < cells.z; m1z ++) {
     for (m1y = 0; m1y < cells.y; m1y ++) {
       for (m1x = 0; m1x < cells.x; m1x ++) {
         VSet (m1v, m1x, m1y, m1z);
-        m1 = VLinear (m1v, cells) + nMol;
+        m1 = VLinear (m1v, cells);
         for (offset = 0; offset < N_OFFSET; offset ++) {
           VAdd (m2v, m1v, vOff[offset]);
           VZero (shift);
           VCellWrapAll ();
-          m2 = VLinear (m2v, cells) + nMol;
+          m2 = VLinear (m2v, cells);
           DO_CELL (j1, m1) {
             DO_CELL (j2, m2) {
               if ((m1 != m2 || j2 < j1) && mol[j1].typeA == 1 &&
@@ -623,7 +609,7 @@ void PutConfig ()
     WriteF (region);
     WriteF (stepCount);
     WriteF (timeNow);
-    AllocMem (rI, NDIM * nMol, short);
+    AllocScratch (rI, 0, NDIM * nMol, short);
     DO_MOL {
       VDiv (w, mol[n].r, region);
       VAddCon (w, w, 0.5);
@@ -633,7 +619,6 @@ void PutConfig ()
     WriteFN (rI, NDIM * nMol);
     DO_MOL rI[n] = ((mol[n].inChain + 1) << 2) + mol[n].typeA;
     WriteFN (rI, nMol);
-    free (rI);
     if (ferror (fp)) fOk = 0;
     fclose (fp);
   } else fOk = 0;
@@ -643,4 +628,5 @@ void PutConfig ()
 #include "in_rand.c"
 #include "in_errexit.c"
 #include "in_namelist.c"
+#include "in_cellbin.c"
 
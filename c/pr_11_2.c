@@ -27,6 +27,7 @@
 
 
 #include "in_mddefs.h"
+#include "in_cellbin.h"
 
 typedef struct {
   RMat rMatT;
@@ -50,7 +51,7 @@ real deltaT, rCut, temperature, timeNow, uSum;
 int moreCycles, randSeed, runId, stepAvg, stepCount, stepLimit;
 real bondAng, bondLen, helixOrder, kinEnVal, tempFinal, tempInit,
    tempReduceFac, totEnVal, twistAng, uCon;
-int *cellList, chainLen, helixPeriod, nDof, nSite, stepAdjustTemp, stepReduceTemp;
+int chainLen, helixPeriod, nDof, nSite, stepAdjustTemp, stepReduceTemp;
 int stepSnap;
 
 NameList nameList[] = {
@@ -150,42 +151,34 @@ void AllocArrays ()
 {
   AllocMem (P.L, chainLen, Link);
   AllocMem (site, nSite, Site);
-  AllocMem (cellList, VProd (cells) + nSite, int);
+  AllocCellBins (VProd (cells), nSite);
 }
 
 
 void ComputeSiteForces ()
 {
-  VecR dr, invWid, rs;
-  VecI cc, m1v, m2v, vOff[] = OFFSET_VALS;
+  VecR dr;
+  VecI m1v, m2v, vOff[] = OFFSET_VALS;
   real fcVal, rr, rrCut, rri, rri3;
-  int c, j1, j2, m1, m1x, m1y, m1z, m2, n, offset;
+  int j1, j2, m1, m1x, m1y, m1z, m2, n, offset;
 
   for (n = 0; n < nSite; n ++) VZero (site[n].f);
   uSum = 0.;
-  VDiv (invWid, cells, region);
-  for (n = nSite; n < nSite + VProd (cells); n ++) cellList[n] = -1;
-  for (n = 0; n < nSite; n ++) {
-    VSAdd (rs, site[n].r, 0.5, region);
-    VMul (cc, rs, invWid);
-    c = VLinear (cc, cells) + nSite;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
-  }
+  BIN_CELLS (site, nSite);
   rrCut = Sqr (rCut);
   for (m1z = 0; m1z < cells.z; m1z ++) {
     for (m1y = 0; m1y < cells.y; m1y ++) {
       for (m1x = 0; m1x < cells.x; m1x ++) {
         VSet (m1v, m1x, m1y, m1z);
-        m1 = VLinear (m1v, cells) + nSite;
-        if (cellList[m1] < 0) continue;
+        m1 = VLinear (m1v, cells);
+        if (CELL_EMPTY (m1)) continue;
         for (offset = 0; offset < N_OFFSET; offset ++) {
           VAdd (m2v, m1v, vOff[offset]);
           if (m2v.x < 0 || m2v.x >= cells.x ||
               m2v.y < 0 || m2v.y >= cells.y ||
                            m2v.z >= cells.z) continue;
-          m2 = VLinear (m2v, cells) + nSite;
-          if (cellList[m2] < 0) continue;
+          m2 = VLinear (m2v, cells);
+          if (CELL_EMPTY (m2)) continue;
           DO_CELL (j1, m1) {
             DO_CELL (j2, m2) {
               if ((m1 != m2 || j2 < j1) && abs (j1 - j2) > 3) {
@@ -723,7 +716,7 @@ void PutConfig ()
     WriteF (totEnVal);
     WriteF (kinEnVal);
     WriteF (helixOrder);
-    AllocMem (rI, NDIM * nSite, short);
+    AllocScratch (rI, 0, NDIM * nSite, short);
     for (n = 0; n < nSite; n ++) {
       VDiv (w, site[n].r, region);
       VAddCon (w, w, 0.5);
@@ -731,7 +724,6 @@ void PutConfig ()
       VToLin (rI, NDIM * n, w);
     }
     WriteFN (rI, NDIM * nSite);
-    free (rI);
     if (ferror (fp)) fOk = 0;
     fclose (fp);
   } else fOk = 0;
@@ -792,4 +784,5 @@ void SolveLineq (real *a, real *x, int n)
 #include "in_rand.c"
 #include "in_errexit.c"
 #include "in_namelist.c"
+#include "in_cellbin.c"
 
@@ -27,6 +27,7 @@
 
 
 #include "in_mddefs.h"
+#include "in_cellbin.h"
 
 typedef struct {
   VecR r, rv, ra, ra1, ra2, ro, rvo;
@@ -39,7 +40,6 @@ real deltaT, density, rCut, temperature, timeNow, uSum, velMag, vvSum;
 Prop kinEnergy, totEnergy;
 int moreCycles, nMol, stepAvg, stepCount, stepEquil, stepLimit;
 VecI cells;
-int *cellList;
 real dispHi, rNebrShell;
 int *nebrTab, nebrNow, nebrTabFac, nebrTabLen, nebrTabMax;
 int *nebrTabPtr;
@@ -130,7 +130,7 @@ void SetParams ()
 void AllocArrays ()
 {
   AllocMem (mol, nMol, Mol);
-  AllocMem (cellList, VProd (cells) + nMol, int);
+  AllocCellBins (VProd (cells), nMol);
   AllocMem (nebrTab, nebrTabMax, int);
   AllocMem (nebrTabPtr, nMol + 1, int);
   AllocMem (histRdf, sizeHistRdf, real);
@@ -150,21 +150,13 @@ void AllocArrays ()
 void BuildNebrList ()
 {
   VecR dr, invWid, rs, shift;
-  VecI cc, m1v, m2v, vOff[] = OFFSET_VALS;
+  VecI m1v, m2v, vOff[] = OFFSET_VALS;
   real rrNebr;
-  int c, j1, j2, m2, n, offset;
+  int j1, j2, m2, offset;
 
   rrNebr = Sqr (rCut + rNebrShell);
   VDiv (invWid, cells, region);
-  for (n = nMol; n < nMol + VProd (cells); n ++)
-     cellList[n] = -1;
-  DO_MOL {
-    VSAdd (rs, mol[n].r, 0.5, region);
-    VMul (cc, rs, invWid);
-    c = VLinear (cc, cells) + nMol;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
-  }
+  BIN_CELLS (mol, nMol);
   nebrTabLen = 0;
   for (j1 = 0; j1 < nMol; j1 ++) {
     VSAdd (rs, mol[j1].r, 0.5, region);
@@ -174,7 +166,7 @@ void BuildNebrList ()
       VAdd (m2v, m1v, vOff[offset]);
       VZero (shift);
       VCellWrapAll ();
-      m2 = VLinear (m2v, cells) + nMol;
+      m2 = VLinear (m2v, cells);
       DO_CELL (j2, m2) {
         if (j2 != j1) {
           VSub (dr, mol[j1].r, mol[j2].r);
@@ -509,4 +501,5 @@ void PrintSummary (FILE *fp)
 #include "in_rand.c"
 #include "in_errexit.c"
 #include "in_namelist.c"
+#include "in_cellbin.c"
 
@@ -29,6 +29,8 @@
 #define NDIM  2
 
 #include "in_mddefs.h"
+#include "in_cellbin.h"
+#include "in_nebrlist.h"
 
 typedef struct {
   VecR r, rv, ra;
@@ -43,9 +45,9 @@ real deltaT, rCut, timeNow, uSum, velMag, vvSum;
 Prop kinEnergy, totEnergy;
 int moreCycles, nMol, stepAvg, stepCount, stepLimit;
 VecI cells;
-int *cellList;
-real dispHi, rNebrShell;
+real rNebrShell;
 int *nebrTab, nebrNow, nebrTabFac, nebrTabLen, nebrTabMax;
+int *nebrTabPtr;
 real embedWt, rSwitch, splineA2, splineA3;
 VecR diskInitPos;
 real diskInitVel, initSep;
@@ -79,6 +81,7 @@ int main (int argc, char **argv)
     if (stepCount % stepSnap == 0) PutConfig ();
     if (stepCount >= stepLimit) moreCycles = 0;
   }
+  PrintNebrStats (stdout, stepCount);
 }
 
 void SetupFiles ()
@@ -103,7 +106,6 @@ void SingleStep ()
   ApplyWallBoundaryCond ();
   if (nebrNow) {
     nebrNow = 0;
-    dispHi = 0.;
     BuildNebrList ();
   }
   ComputeForces ();
@@ -150,56 +152,18 @@ void SetParams ()
 void AllocArrays ()
 {
   AllocMem (mol, nMol, Mol);
-  AllocMem (cellList, VProd (cells) + nMol, int);
-  AllocMem (nebrTab, 2 * nebrTabMax, int);
+  AllocCellBins (VProd (cells), nMol);
+  AllocMem (nebrTab, nebrTabMax, int);
+  AllocMem (nebrTabPtr, nMol + 1, int);
+  AllocMem (nebrRefR, nMol, VecR);
 }
 
 
 void BuildNebrList ()
 {
-  VecR dr, invWid, rs, shift;
-  VecI cc, m1v, m2v, vOff[] = OFFSET_VALS;
-  real rrNebr;
-  int c, j1, j2, m1, m1x, m1y, m2, n, offset;
-
-  rrNebr = Sqr (rCut + rNebrShell);
-  VDiv (invWid, cells, region);
-  for (n = nMol; n < nMol + VProd (cells); n ++) cellList[n] = -1;
-  DO_MOL {
-    VSAdd (rs, mol[n].r, 0.5, region);
-    VMul (cc, rs, invWid);
-    c = VLinear (cc, cells) + nMol;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
-  }
-  nebrTabLen = 0;
-  for (m1y = 0; m1y < cells.y; m1y ++) {
-    for (m1x = 0; m1x < cells.x; m1x ++) {
-      VSet (m1v, m1x, m1y);
-      m1 = VLinear (m1v, cells) + nMol;
-      for (offset = 0; offset < N_OFFSET; offset ++) {
-        VAdd (m2v, m1v, vOff[offset]);
-        VZero (shift);
-        VCellWrapAll ();
-        m2 = VLinear (m2v, cells) + nMol;
-        DO_CELL (j1, m1) {
-          DO_CELL (j2, m2) {
-            if (m1 != m2 || j2 < j1) {
-              VSub (dr, mol[j1].r, mol[j2].r);
-              VVSub (dr, shift);
-              if (VLenSq (dr) < rrNebr) {
-                if (nebrTabLen >= nebrTabMax)
-                   ErrExit (ERR_TOO_MANY_NEBRS);
-                nebrTab[2 * nebrTabLen] = j1;
-                nebrTab[2 * nebrTabLen + 1] = j2;
-                ++ nebrTabLen;
-              }
-            }
-          }
-        }
-      }
-    }
-  }
+  BIN_CELLS (mol, nMol);
+  BUILD_NEBR_TAB (mol, nMol, rCut + rNebrShell);
+  SAVE_NEBR_REF (mol, nMol);
 }
 
 
@@ -216,16 +180,17 @@ void ComputeForces ()
   rrCdi = 1. / Sqr (rrCut - Sqr (rCutC));
   rrSwitch = Sqr (rSwitch);
   DO_MOL mol[n].logRho = 0.;
-  for (n = 0; n < nebrTabLen; n ++) {
-    j1 = nebrTab[2 * n];
-    j2 = nebrTab[2 * n + 1];
-    VSub (dr, mol[j1].r, mol[j2].r);
-    VWrapAll (dr);
-    rr = VLenSq (dr);
-    if (rr < rrCut) {
-      t = Sqr (rrCut - rr);
-      mol[j1].logRho += t;
-      mol[j2].logRho += t;
+  for (j1 = 0; j1 < nMol; j1 ++) {
+    for (n = nebrTabPtr[j1]; n < nebrTabPtr[j1 + 1]; n ++) {
+      j2 = nebrTab[n];
+      VSub (dr, mol[j1].r, mol[j2].r);
+      VWrapAll (dr);
+      rr = VLenSq (dr);
+      if (rr < rrCut) {
+        t = Sqr (rrCut - rr);
+        mol[j1].logRho += t;
+        mol[j2].logRho += t;
+      }
     }
   }
   DO_MOL {
@@ -234,28 +199,29 @@ void ComputeForces ()
   }
   DO_MOL VZero (mol[n].ra);
   uSum = 0.;
-  for (n = 0; n < nebrTabLen; n ++) {
-    j1 = nebrTab[2 * n];
-    j2 = nebrTab[2 * n + 1];
-    VSub (dr, mol[j1].r, mol[j2].r);
-    VWrapAll (dr);
-    rr = VLenSq (dr);
-    if (rr < rrCut) {
-      rrd = rrCut - rr;
-      if (rr < rrSwitch) {
-        rri = 1. / rr;
-        rri3 = Cube (rri);
-        fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
-        uVal = 4. * rri3 * (rri3 - 1.);
-      } else {
-        fcVal = (4. * splineA2 + 6. * splineA3 * rrd) * rrd;
-        uVal = (splineA2 + splineA3 * rrd) * Sqr (rrd);
+  for (j1 = 0; j1 < nMol; j1 ++) {
+    for (n = nebrTabPtr[j1]; n < nebrTabPtr[j1 + 1]; n ++) {
+      j2 = nebrTab[n];
+      VSub (dr, mol[j1].r, mol[j2].r);
+      VWrapAll (dr);
+      rr = VLenSq (dr);
+      if (rr < rrCut) {
+        rrd = rrCut - rr;
+        if (rr < rrSwitch) {
+          rri = 1. / rr;
+          rri3 = Cube (rri);
+          fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
+          uVal = 4. * rri3 * (rri3 - 1.);
+        } else {
+          fcVal = (4. * splineA2 + 6. * splineA3 * rrd) * rrd;
+          uVal = (splineA2 + splineA3 * rrd) * Sqr (rrd);
+        }
+        fcVal = embedWt * fcVal + (1. - embedWt) * 2. * rrCdi *
+           (mol[j1].logRho + mol[j2].logRho + 2.) * rrd;
+        VVSAdd (mol[j1].ra, fcVal, dr);
+        VVSAdd (mol[j2].ra, - fcVal, dr);
+        uSum += uVal;
       }
-      fcVal = embedWt * fcVal + (1. - embedWt) * 2. * rrCdi *
-         (mol[j1].logRho + mol[j2].logRho + 2.) * rrd;
-      VVSAdd (mol[j1].ra, fcVal, dr);
-      VVSAdd (mol[j2].ra, - fcVal, dr);
-      uSum += uVal;
     }
   }
   t = 0.;
@@ -285,10 +251,13 @@ void LeapfrogStep (int part)
   int n;
 
   if (part == 1) {
+    NEBR_DISP_ZERO;
     DO_MOL {
       VVSAdd (mol[n].rv, 0.5 * deltaT, mol[n].ra);
       VVSAdd (mol[n].r, deltaT, mol[n].rv);
+      NEBR_DISP_TRACK (mol[n].r, n);
     }
+    if (NEBR_DISP_OVER (rNebrShell)) nebrNow = 1;
   } else {
     DO_MOL VVSAdd (mol[n].rv, 0.5 * deltaT, mol[n].ra);
   }
@@ -416,20 +385,16 @@ void InitAccels ()
 
 void EvalProps ()
 {
-  real vv, vvMax;
+  real vv;
   int n;
 
   VZero (vSum);
   vvSum = 0.;
-  vvMax = 0.;
   DO_MOL {
     VVAdd (vSum, mol[n].rv);
     vv = VLenSq (mol[n].rv);
     vvSum += vv;
-    vvMax = Max (vvMax, vv);
   }
-  dispHi += sqrt (vvMax) * deltaT;
-  if (dispHi > 0.5 * rNebrShell) nebrNow = 1;
   kinEnergy.val = 0.5 * vvSum / nMol;
   totEnergy.val = kinEnergy.val + uSum / nMol;
 }
@@ -478,7 +443,7 @@ void PutConfig ()
     WriteF (region);
     WriteF (stepCount);
     WriteF (timeNow);
-    AllocMem (rI, NDIM * nMol, short);
+    AllocScratch (rI, 0, NDIM * nMol, short);
     DO_MOL {
       VDiv (w, mol[n].r, region);
       VAddCon (w, w, 0.5);
@@ -488,7 +453,6 @@ void PutConfig ()
     WriteFN (rI, NDIM * nMol);
     DO_MOL rI[n] = mol[n].inObj;
     WriteFN (rI, nMol);
-    free (rI);
     if (ferror (fp)) fOk = 0;
     fclose (fp);
   } else fOk = 0;
@@ -498,4 +462,6 @@ void PutConfig ()
 #include "in_rand.c"
 #include "in_errexit.c"
 #include "in_namelist.c"
+#include "in_cellbin.c"
+#include "in_nebrlist.c"
 
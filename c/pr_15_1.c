@@ -640,13 +640,12 @@ void PutGridAverage ()
     WriteF (sizeHistGrid);
     WriteF (snapNumber);
     WriteF (timeNow);
-    AllocMem (hI, hSize, short);
+    AllocScratch (hI, 0, hSize, short);
     for (j = 0; j < NHIST; j ++) {
       for (n = 0; n < hSize; n ++)
          hI[n] = SCALE_FAC * histGrid[j][n] / histMax[j];
       WriteFN (hI, hSize);
     }
-    free (hI);
     if (ferror (fp)) fOk = 0;
     fclose (fp);
   } else fOk = 0;
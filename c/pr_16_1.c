@@ -29,6 +29,8 @@
 #define NDIM  2
 
 #include "in_mddefs.h"
+#include "in_cellbin.h"
+#include "in_nebrlist.h"
 
 typedef struct {
   VecR r, rv, ra;
@@ -41,9 +43,9 @@ VecI initUcell;
 real deltaT, rCut, kinEnergy, timeNow, velMag;
 int moreCycles, nMol, stepAvg, stepCount, stepLimit;
 VecI cells;
-int *cellList;
-real dispHi, rNebrShell;
+real rNebrShell;
 int *nebrTab, nebrNow, nebrTabFac, nebrTabLen, nebrTabMax;
+int *nebrTabPtr;
 real basePos, baseVel, curPhase, fricDyn, fricStat, gravField,
    inertiaK, vibAmp, vibFreq;
 int nBaseCycle;
@@ -78,6 +80,7 @@ int main (int argc, char **argv)
     if (stepCount % stepSnap == 0) PutConfig ();
     if (stepCount >= stepLimit) moreCycles = 0;
   }
+  PrintNebrStats (stdout, stepCount);
 }
 
 void SetupFiles ()
@@ -103,7 +106,6 @@ void SingleStep ()
   ApplyBoundaryCond ();
   if (nebrNow) {
     nebrNow = 0;
-    dispHi = 0.;
     BuildNebrList ();
   }
   ComputeForces ();
@@ -141,59 +143,37 @@ void SetParams ()
 void AllocArrays ()
 {
   AllocMem (mol, nMol, Mol);
-  AllocMem (cellList, VProd (cells) + nMol, int);
-  AllocMem (nebrTab, 2 * nebrTabMax, int);
+  AllocCellBins (VProd (cells), nMol);
+  AllocMem (nebrTab, nebrTabMax, int);
+  AllocMem (nebrTabPtr, nMol + 1, int);
+  AllocMem (nebrRefR, nMol, VecR);
 }
 
+#define NEBR_CELL_WRAP                                      \
+   {VCellWrap (x);                                          \
+   if (m2v.y >= cells.y) continue;}
+#define NEBR_PAIR_IN(j1, j2, rr)                            \
+   ((rr) < Sqr (rCut * (0.5 * (mol[j1].diam +               \
+   mol[j2].diam)) + rNebrShell))
+
 void BuildNebrList ()
 {
-  VecR dr, invWid, rs, shift;
-  VecI cc, m1v, m2v, vOff[] = OFFSET_VALS, zz;
-  real dFac;
-  int c, j1, j2, m1, m1x, m1y, m2, n, offset;
+  VecR invWid, rs;
+  VecI cc, zz;
+  int n;
 
   VDiv (invWid, cells, region);
-  for (n = nMol; n < nMol + VProd (cells); n ++) cellList[n] = -1;
   VZero (zz);
   DO_MOL {
     VSAdd (rs, mol[n].r, 0.5, region);
     VMul (cc, rs, invWid);
     if (! (VGe (cc, zz) && VLt (cc, cells)))
        ErrExit (ERR_OUTSIDE_REGION);
-    c = VLinear (cc, cells) + nMol;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
-  }
-  nebrTabLen = 0;
-  for (m1y = 0; m1y < cells.y; m1y ++) {
-    for (m1x = 0; m1x < cells.x; m1x ++) {
-      VSet (m1v, m1x, m1y);
-      m1 = VLinear (m1v, cells) + nMol;
-      for (offset = 0; offset < N_OFFSET; offset ++) {
-        VAdd (m2v, m1v, vOff[offset]);
-        VZero (shift);
-        VCellWrap (x);
-        if (m2v.y >= cells.y) continue;
-        m2 = VLinear (m2v, cells) + nMol;
-        DO_CELL (j1, m1) {
-          DO_CELL (j2, m2) {
-            if (m1 != m2 || j2 < j1) {
-              VSub (dr, mol[j1].r, mol[j2].r);
-              VVSub (dr, shift);
-              dFac = 0.5 * (mol[j1].diam + mol[j2].diam);
-              if (VLenSq (dr) < Sqr (rCut * dFac + rNebrShell)) {
-                if (nebrTabLen >= nebrTabMax)
-                   ErrExit (ERR_TOO_MANY_NEBRS);
-                nebrTab[2 * nebrTabLen] = j1;
-                nebrTab[2 * nebrTabLen + 1] = j2;
-                ++ nebrTabLen;
-              }
-            }
-          }
-        }
-      }
-    }
+    cellOf[n] = VLinear (cc, cells);
   }
+  SortCellBins (nMol, VProd (cells));
+  BUILD_NEBR_TAB (mol, nMol, rCut + rNebrShell);
+  SAVE_NEBR_REF (mol, nMol);
 }
 
 void ComputeForces ()
@@ -206,37 +186,38 @@ void ComputeForces ()
     VZero (mol[n].ra);
     mol[n].wa = 0.;
   }
-  for (n = 0; n < nebrTabLen; n ++) {
-    j1 = nebrTab[2 * n];
-    j2 = nebrTab[2 * n + 1];
-    dFac = 0.5 * (mol[j1].diam + mol[j2].diam);
-    VSub (dr, mol[j1].r, mol[j2].r);
-    VWrap (dr, x);
-    rr = VLenSq (dr);
-    if (rr < Sqr (rCut * dFac)) {
-      rSep = sqrt (rr);
-      rri = Sqr (dFac) / rr;
-      rri3 = Cube (rri);
-      fcVal = 48. * rri3 * (rri3 - 0.5) / rr;
-      VSub (dv, mol[j1].rv, mol[j2].rv);
-      drv = VDot (dr, dv);
-      fcVal -= fricDyn * drv / rr;
-      VVSAdd (mol[j1].ra, fcVal, dr);
-      VVSAdd (mol[j2].ra, - fcVal, dr);
-      VVSAdd (dv, - drv / rr, dr);
-      ws = (mol[j1].diam * mol[j1].wv + mol[j2].diam * mol[j2].wv) /
-         (mol[j1].diam + mol[j2].diam);
-      dv.x += ws * dr.y;
-      dv.y -= ws * dr.x;
-      vRel = VLen (dv);
-      ftLim = fricStat * fabs (fcVal) * rSep / vRel;
-      ft = - Min (ftLim, fricDyn);
-      VVSAdd (mol[j1].ra, ft, dv);
-      VVSAdd (mol[j2].ra, - ft, dv);
-      wt = ft * vRel;
-      if (VCross (dr, dv) > 0.) wt = - wt;
-      mol[j1].wa += wt;
-      mol[j2].wa += wt;
+  for (j1 = 0; j1 < nMol; j1 ++) {
+    for (n = nebrTabPtr[j1]; n < nebrTabPtr[j1 + 1]; n ++) {
+      j2 = nebrTab[n];
+      dFac = 0.5 * (mol[j1].diam + mol[j2].diam);
+      VSub (dr, mol[j1].r, mol[j2].r);
+      VWrap (dr, x);
+      rr = VLenSq (dr);
+      if (rr < Sqr (rCut * dFac)) {
+        rSep = sqrt (rr);
+        rri = Sqr (dFac) / rr;
+        rri3 = Cube (rri);
+        fcVal = 48. * rri3 * (rri3 - 0.5) / rr;
+        VSub (dv, mol[j1].rv, mol[j2].rv);
+        drv = VDot (dr, dv);
+        fcVal -= fricDyn * drv / rr;
+        VVSAdd (mol[j1].ra, fcVal, dr);
+        VVSAdd (mol[j2].ra, - fcVal, dr);
+        VVSAdd (dv, - drv / rr, dr);
+        ws = (mol[j1].diam * mol[j1].wv + mol[j2].diam * mol[j2].wv) /
+           (mol[j1].diam + mol[j2].diam);
+        dv.x += ws * dr.y;
+        dv.y -= ws * dr.x;
+        vRel = VLen (dv);
+        ftLim = fricStat * fabs (fcVal) * rSep / vRel;
+        ft = - Min (ftLim, fricDyn);
+        VVSAdd (mol[j1].ra, ft, dv);
+        VVSAdd (mol[j2].ra, - ft, dv);
+        wt = ft * vRel;
+        if (VCross (dr, dv) > 0.) wt = - wt;
+        mol[j1].wa += wt;
+        mol[j2].wa += wt;
+      }
     }
   }
   ComputeBdyForces ();
@@ -282,11 +263,14 @@ void LeapfrogStep (int part)
   int n;
 
   if (part == 1) {
+    NEBR_DISP_ZERO;
     DO_MOL {
       VVSAdd (mol[n].rv, 0.5 * deltaT, mol[n].ra);
       VVSAdd (mol[n].r, deltaT, mol[n].rv);
       mol[n].wv += 0.5 * deltaT * mol[n].wa;
+      NEBR_DISP_TRACK (mol[n].r, n);
     }
+    if (NEBR_DISP_OVER (rNebrShell)) nebrNow = 1;
   } else {
     DO_MOL {
       VVSAdd (mol[n].rv, 0.5 * deltaT, mol[n].ra);
@@ -304,19 +288,15 @@ void ApplyBoundaryCond ()
 
 void EvalProps ()
 {
-  real vv, vvMax, vvSum;
+  real vv, vvSum;
   int n;
 
   vvSum = 0.;
-  vvMax = 0.;
   DO_MOL {
     vv = VLenSq (mol[n].rv);
-    if (vv > vvMax) vvMax = vv;
     vvSum += Sqr (mol[n].diam) * (vv + inertiaK *
        Sqr (mol[n].diam) * Sqr (mol[n].wv));
   }
-  dispHi += sqrt (vvMax) * deltaT;
-  if (dispHi > 0.5 * rNebrShell) nebrNow = 1;
   kinEnergy = 0.5 * vvSum / nMol;
 }
 
@@ -404,7 +384,7 @@ void PutConfig ()
     WriteF (region);
     WriteF (stepCount);
     WriteF (timeNow);
-    AllocMem (rI, NDIM * nMol, short);
+    AllocScratch (rI, 0, NDIM * nMol, short);
     DO_MOL {
       VDiv (w, mol[n].r, region);
       VAddCon (w, w, 0.5);
@@ -412,7 +392,6 @@ void PutConfig ()
       VToLin (rI, NDIM * n, w);
     }
     WriteFN (rI, NDIM * nMol);
-    free (rI);
     if (ferror (fp)) fOk = 0;
     fclose (fp);
   } else fOk = 0;
@@ -422,4 +401,6 @@ void PutConfig ()
 #include "in_rand.c"
 #include "in_errexit.c"
 #include "in_namelist.c"
+#include "in_cellbin.c"
+#include "in_nebrlist.c"
 
@@ -31,6 +31,7 @@
 /* for compile: -I/usr/include/openmpi-x86_64 -L/usr/lib64/openmpi/lib -lmpi */
 
 #include "in_mddefs.h"
+#include "in_cellbin.h"
 
 #include <mpi.h>
 
@@ -105,9 +106,9 @@ real deltaT, density, rCut, temperature, timeNow, uSum, velMag, vvSum;
 Prop kinEnergy, totEnergy;
 int moreCycles, nMol, randSeed, stepAvg, stepCount, stepEquil, stepLimit;
 VecI cells;
-int *cellList;
 real dispHi, rNebrShell;
 int *nebrTab, nebrNow, nebrTabFac, nebrTabLen, nebrTabMax;
+int *nebrTabPtr;
 real virSum;
 Prop pressure;
 VecR subRegionHi, subRegionLo;
@@ -183,8 +184,9 @@ void AllocArrays ()
   int k;
 
   AllocMem (mol, nMolMeMax, Mol);
-  AllocMem (cellList, VProd (cells) + nMolMeMax, int);
-  AllocMem (nebrTab, 2 * nebrTabMax, int);
+  AllocCellBins (VProd (cells), nMolMeMax);
+  AllocMem (nebrTab, nebrTabMax, int);
+  AllocMem (nebrTabPtr, nMolMeMax + 1, int);
   AllocMem (trBuff, NDIM * trBuffMax, real);
   AllocMem2 (trPtr, 2, NDIM * trBuffMax, int);
 }
@@ -249,7 +251,7 @@ void BuildNebrList ()
   VecR cellBase, dr, invWid, rs, t1, t2;
   VecI cc, m1v, m2v, vOff[] = OFFSET_VALS;
   real rrNebr;
-  int c, indx, j1, j2, m1, m1x, m1y, m1z, m2, n, offset, tOffset,
+  int indx, j1, j2, m1, m2, n, offset, tOffset,
      vOffList[][N_OFFSET] = OFFSET_LIST, vOffTableLen[] = OFFSET_LEN;
 
   VAddCon (t1, cells, -2.);
@@ -259,56 +261,49 @@ void BuildNebrList ()
   VDiv (t1, t1, invWid);
   VSub (cellBase, subRegionLo, t1);
   rrNebr = Sqr (rCut + rNebrShell);
-  for (n = nMolMe + nMolCopy; n < nMolMe + nMolCopy +
-     VProd (cells); n ++) cellList[n] = -1;
   for (n = 0; n < nMolMe + nMolCopy; n ++) {
     VSub (rs, mol[n].r, cellBase);
     VMul (cc, rs, invWid);
-    c = VLinear (cc, cells) + nMolMe + nMolCopy;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
+    cellOf[n] = VLinear (cc, cells);
   }
+  SortCellBins (nMolMe + nMolCopy, VProd (cells));
   nebrTabLen = 0;
-  for (m1z = 0; m1z < cells.z - 1; m1z ++) {
-    for (m1y = 0; m1y < cells.y; m1y ++) {
-      for (m1x = 0; m1x < cells.x; m1x ++) {
-        VSet (m1v, m1x, m1y, m1z);
-        tOffset = 13;
-        if (m1z == 0) tOffset -= 9;
-        if (m1y == 0) tOffset -= 3;
-        else if (m1y == cells.y - 1) tOffset += 3;
-        if (m1x == 0) tOffset -= 1;
-        else if (m1x == cells.x - 1) tOffset += 1;
-        m1 = VLinear (m1v, cells) + nMolMe + nMolCopy;
-        for (offset = 0; offset < vOffTableLen[tOffset]; offset ++) {
-          indx = vOffList[tOffset][offset];
-          VAdd (m2v, m1v, vOff[indx]);
-          m2 = VLinear (m2v, cells) + nMolMe + nMolCopy;
-          DO_CELL (j1, m1) {
-            DO_CELL (j2, m2) {
-              if (m1 != m2 || j2 < j1) {
-                VSub (dr, mol[j1].r, mol[j2].r);
-                if (VLenSq (dr) < rrNebr) {
-                  nebrTab[2 * nebrTabLen] = j1;
-                  nebrTab[2 * nebrTabLen + 1] = j2;
-                  ++ nebrTabLen;
-                  if (nebrTabLen >= nebrTabMax) {
-                    errCode = ERR_TOO_MANY_NEBRS;
-                    -- nebrTabLen;
-                  }
-                }
-              }
+  for (j1 = 0; j1 < nMolMe + nMolCopy; j1 ++) {
+    nebrTabPtr[j1] = nebrTabLen;
+    m1 = cellOf[j1];
+    VCellVec (m1v, m1);
+    if (m1v.z == cells.z - 1) continue;
+    tOffset = 13;
+    if (m1v.z == 0) tOffset -= 9;
+    if (m1v.y == 0) tOffset -= 3;
+    else if (m1v.y == cells.y - 1) tOffset += 3;
+    if (m1v.x == 0) tOffset -= 1;
+    else if (m1v.x == cells.x - 1) tOffset += 1;
+    for (offset = 0; offset < vOffTableLen[tOffset]; offset ++) {
+      indx = vOffList[tOffset][offset];
+      VAdd (m2v, m1v, vOff[indx]);
+      m2 = VLinear (m2v, cells);
+      DO_CELL (j2, m2) {
+        if (m1 != m2 || j2 < j1) {
+          VSub (dr, mol[j1].r, mol[j2].r);
+          if (VLenSq (dr) < rrNebr) {
+            nebrTab[nebrTabLen] = j2;
+            ++ nebrTabLen;
+            if (nebrTabLen >= nebrTabMax) {
+              errCode = ERR_TOO_MANY_NEBRS;
+              -- nebrTabLen;
             }
           }
         }
       }
     }
   }
+  nebrTabPtr[nMolMe + nMolCopy] = nebrTabLen;
 }
 
 void ComputeForces ()
 {
-  VecR dr;
+  VecR dr, fi, ri;
   real fcVal, rr, rrCut, rri, rri3, uVal;
   int j1, j2, n;
 
@@ -316,27 +311,31 @@ void ComputeForces ()
   for (n = 0; n < nMolMe + nMolCopy; n ++) VZero (mol[n].ra);
   uSum = 0.;
   virSum = 0.;
-  for (n = 0; n < nebrTabLen; n ++) {
-    j1 = nebrTab[2 * n];
-    j2 = nebrTab[2 * n + 1];
-    VSub (dr, mol[j1].r, mol[j2].r);
-    rr = VLenSq (dr);
-    if (rr < rrCut) {
-      rri = 1. / rr;
-      rri3 = Cube (rri);
-      fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
-      uVal = 4. * rri3 * (rri3 - 1.) + 1.;
-      VVSAdd (mol[j1].ra, fcVal, dr);
-      VVSAdd (mol[j2].ra, - fcVal, dr);
-      if (j1 < nMolMe) {
-        uSum += uVal;
-        virSum += fcVal * rr;
-      }
-      if (j2 < nMolMe) {
-        uSum += uVal;
-        virSum += fcVal * rr;
+  for (j1 = 0; j1 < nMolMe + nMolCopy; j1 ++) {
+    ri = mol[j1].r;
+    VZero (fi);
+    for (n = nebrTabPtr[j1]; n < nebrTabPtr[j1 + 1]; n ++) {
+      j2 = nebrTab[n];
+      VSub (dr, ri, mol[j2].r);
+      rr = VLenSq (dr);
+      if (rr < rrCut) {
+        rri = 1. / rr;
+        rri3 = Cube (rri);
+        fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
+        uVal = 4. * rri3 * (rri3 - 1.) + 1.;
+        VVSAdd (fi, fcVal, dr);
+        VVSAdd (mol[j2].ra, - fcVal, dr);
+        if (j1 < nMolMe) {
+          uSum += uVal;
+          virSum += fcVal * rr;
+        }
+        if (j2 < nMolMe) {
+          uSum += uVal;
+          virSum += fcVal * rr;
+        }
       }
     }
+    VVAdd (mol[j1].ra, fi);
   }
   uSum *= 0.5;
   virSum *= 0.5;
@@ -783,4 +782,5 @@ void UnpackValList (ValList *list, int size)
 #include "in_rand.c"
 #include "in_errexit.c"
 #include "in_namelist.c"
+#include "in_cellbin.c"
 
@@ -29,23 +29,9 @@
 /* link with -lpthread */
 
 #include "in_mddefs.h"
-
-#include <pthread.h>
-
-#define QUERY_THREAD()  ip = (long) tr
-#define QUERY_STAGE  funcStage
-#define THREAD_PROC_LOOP(tProc, fStage)                     \
-   funcStage = fStage;                                      \
-   for (ip = 1; ip < nThread; ip ++)                        \
-      pthread_create (&pThread[ip], NULL,                   \
-      tProc, (void *) ip);                                  \
-   tProc ((void *) 0);                                      \
-    for (ip = 1; ip < nThread; ip ++)                       \
-      pthread_join (pThread[ip], NULL);
-#define THREAD_SPLIT_LOOP(j, jMax)                          \
-  for (j = ip * jMax / nThread;                             \
-     j < (ip + 1) * jMax / nThread; j ++)
-#define THREAD_LOOP  for (iq = 0; iq < nThread; iq ++)
+#include "in_cellbin.h"
+#include "in_nebrlist.h"
+#include "in_thread.h"
 
 typedef struct {
   VecR r, rv, ra;
@@ -58,19 +44,27 @@ real deltaT, density, rCut, temperature, timeNow, uSum, velMag, vvSum;
 Prop kinEnergy, totEnergy;
 int moreCycles, nMol, stepAvg, stepCount, stepEquil, stepLimit;
 VecI cells;
-int *cellList;
-real dispHi, rNebrShell;
+real rNebrShell;
 real kinEnInitSum;
 int stepInitlzTemp;
-pthread_t *pThread;
 VecR **raP;
-real *uSumP;
-int **nebrTabP, *nebrTabLenP, nebrNow, nebrTabFac, nebrTabMax, funcStage, nThread;
+real *dispSqP, *uSumP;
+int **nebrTabP, nebrNow, nebrTabFac, nebrTabMax;
+int *nebrTab, *nebrTabPtr, nebrTabLen;
+int **cellCountP, *cellSumP;
+int *nebrChunkLen, *nebrChunkOff, *nebrChunkPos, *nebrTabS, nebrTabOver,
+   nebrTabUsed;
+real *forceTaskTime, *nebrChunkTime;
+int benchDispatch;
+
+#define TASK_LEN  64
 
 NameList nameList[] = {
+  NameI (benchDispatch),
   NameR (deltaT),
   NameR (density),
   NameI (initUcell),
+  NameI (nebrFull),
   NameI (nebrTabFac),
   NameI (nThread),
   NameR (rNebrShell),
@@ -79,6 +73,9 @@ NameList nameList[] = {
   NameI (stepInitlzTemp),
   NameI (stepLimit),
   NameR (temperature),
+  NameI (threadSpin),
+  NameI (threadStats),
+  NameI (threadSteal),
 };
 
 
@@ -88,11 +85,17 @@ int main (int argc, char **argv)
   PrintNameList (stdout);
   SetParams ();
   SetupJob ();
+  if (benchDispatch > 0) {
+    BenchThreads (benchDispatch);
+    exit (0);
+  }
   moreCycles = 1;
   while (moreCycles) {
     SingleStep ();
     if (stepCount >= stepLimit) moreCycles = 0;
   }
+  PrintNebrStats (stdout, stepCount);
+  if (threadStats) PrintThreadStats (stdout);
 }
 
 
@@ -104,7 +107,6 @@ void SingleStep ()
   ApplyBoundaryCond ();
   if (nebrNow) {
     nebrNow = 0;
-    dispHi = 0.;
     BuildNebrList ();
   }
   ComputeForces ();
@@ -138,7 +140,7 @@ void SetParams ()
   nMol = VProd (initUcell);
   velMag = sqrt (NDIM * (1. - 1. / nMol) * temperature);
   VSCopy (cells, 1. / (rCut + rNebrShell), region);
-  nebrTabMax = nebrTabFac * nMol;
+  nebrTabMax = (nebrFull ? 2 : 1) * nebrTabFac * nMol;
 }
 
 void AllocArrays ()
@@ -146,156 +148,287 @@ void AllocArrays ()
   int k;
 
   AllocMem (mol, nMol, Mol);
-  AllocMem (cellList, VProd (cells) + nMol, int);
-  AllocMem (pThread, nThread, pthread_t);
+  AllocCellBins (VProd (cells), nMol);
+  InitThreads ();
   AllocMem (uSumP, nThread, real);
-  AllocMem (nebrTabLenP, nThread, int);
-  AllocMem2 (raP, nThread, nMol, VecR);
-  AllocMem2 (nebrTabP, nThread, 2 * nebrTabMax / nThread, int);
+  if (! nebrFull) {
+    AllocMem2 (raP, nThread, nMol, VecR);
+  }
+  AllocMem2 (nebrTabP, nThread, nebrTabMax / nThread, int);
+  AllocMem (nebrTab, nebrTabMax, int);
+  AllocMem (nebrTabPtr, nMol + 1, int);
+  AllocMem (nebrRefR, nMol, VecR);
+  AllocMem (dispSqP, 2 * nThread, real);
+  AllocMem2 (cellCountP, nThread, VProd (cells), int);
+  AllocMem (cellSumP, nThread, int);
+  AllocMem (nebrTabS, nebrTabMax, int);
+  AllocMem (nebrChunkLen, nMol / TASK_LEN + 1, int);
+  AllocMem (nebrChunkOff, nMol / TASK_LEN + 1, int);
+  AllocMem (nebrChunkPos, nMol / TASK_LEN + 1, int);
+  AllocMem (nebrChunkTime, nMol / TASK_LEN + 1, real);
+  AllocMem (forceTaskTime, nMol / TASK_LEN + 1, real);
+  for (k = 0; k <= nMol / TASK_LEN; k ++)
+     nebrChunkTime[k] = forceTaskTime[k] = 0.;
+  THREAD_TOUCH (mol, nMol);
+  THREAD_TOUCH (cellOf, nMol);
+  THREAD_TOUCH (nebrRefR, nMol);
 }
 
+/* the cell binning is a counting sort in which each thread counts its
+   own range of particles per cell, the counts are turned into offsets
+   by a prefix sum over (cell, thread) pairs done in ranges of cells,
+   and each thread then places its particles; the neighbor list rows
+   are built in chunks of TASK_LEN particles, each in a private buffer
+   from which it is appended to a shared staging area, and the chunks
+   are then copied into place using a prefix sum of their lengths; if
+   a buffer or the staging area overflows, the storage is enlarged and
+   the rows are built again */
+
 void BuildNebrList ()
 {
-  int n;
-  long ip;
+  int iq, n, t;
 
-  for (n = nMol; n < nMol + VProd (cells); n ++) cellList[n] = -1;
   THREAD_PROC_LOOP (BuildNebrListT, 1);
   THREAD_PROC_LOOP (BuildNebrListT, 2);
+  n = 0;
+  THREAD_LOOP {
+    n += cellSumP[iq];
+    cellSumP[iq] = n - cellSumP[iq];
+  }
+  THREAD_PROC_LOOP (BuildNebrListT, 3);
+  cellStart[VProd (cells)] = nMol;
+  THREAD_PROC_LOOP (BuildNebrListT, 4);
+  SetCellStencil (rCut + rNebrShell);
+  do {
+    nebrTabUsed = 0;
+    nebrTabOver = 0;
+    SetThreadTasks (nMol, TASK_LEN, NULL, nebrChunkTime);
+    THREAD_PROC_LOOP (BuildNebrListT, 5);
+    if (nebrTabOver) GrowNebrTab ();
+  } while (nebrTabOver);
+  nebrTabLen = 0;
+  for (t = 0; t < (nMol + TASK_LEN - 1) / TASK_LEN; t ++) {
+    nebrChunkOff[t] = nebrTabLen;
+    nebrTabLen += nebrChunkLen[t];
+  }
+  SetThreadTasks (nMol, TASK_LEN, NULL, NULL);
+  THREAD_PROC_LOOP (BuildNebrListT, 6);
+  nebrTabPtr[nMol] = nebrTabLen;
+  SAVE_NEBR_REF (mol, nMol);
+}
+
+void GrowNebrTab ()
+{
+  int k;
+
+  nebrTabMax += nebrTabMax / 2 + nMol;
+  free (nebrTabP[0]);
+  free (nebrTabP);
+  free (nebrTab);
+  free (nebrTabS);
+  AllocMem2 (nebrTabP, nThread, nebrTabMax / nThread, int);
+  AllocMem (nebrTab, nebrTabMax, int);
+  AllocMem (nebrTabS, nebrTabMax, int);
 }
 
 void *BuildNebrListT (void *tr)
 {
-  VecR dr, invWid, rs, shift;
-  VecI cc, m1v, m2v, vOff[] = OFFSET_VALS;
-  real rrNebr;
-  int c, j1, j2, m1, m1x, m1y, m1z, m2, n, offset;
-  int ip;
+  VecR invWid, rs;
+  VecI cc;
+  int c, j1, n, nc, nTab, t;
+  int ip, iq;
 
   QUERY_THREAD ();
+  nc = VProd (cells);
   switch (QUERY_STAGE) {
     case 1:
       VDiv (invWid, cells, region);
-      DO_MOL {
+      for (c = 0; c < nc; c ++) cellCountP[ip][c] = 0;
+      THREAD_SPLIT_LOOP (n, nMol) {
         VSAdd (rs, mol[n].r, 0.5, region);
         VMul (cc, rs, invWid);
-        if (cc.z % nThread == ip) {
-          c = VLinear (cc, cells) + nMol;
-          cellList[n] = cellList[c];
-          cellList[c] = n;
-        }
+        cellOf[n] = VLinear (cc, cells);
+        ++ cellCountP[ip][cellOf[n]];
       }
       break;
     case 2:
-      rrNebr = Sqr (rCut + rNebrShell);
-      nebrTabLenP[ip] = 0;
-      THREAD_SPLIT_LOOP (m1z, cells.z) {
-        for (m1y = 0; m1y < cells.y; m1y ++) {
-          for (m1x = 0; m1x < cells.x; m1x ++) {
-            VSet (m1v, m1x, m1y, m1z);
-            m1 = VLinear (m1v, cells) + nMol;
-            for (offset = 0; offset < N_OFFSET; offset ++) {
-              VAdd (m2v, m1v, vOff[offset]);
-              VZero (shift);
-              VCellWrapAll ();
-              m2 = VLinear (m2v, cells) + nMol;
-              DO_CELL (j1, m1) {
-                DO_CELL (j2, m2) {
-                  if (m1 != m2 || j2 < j1) {
-                    VSub (dr, mol[j1].r, mol[j2].r);
-                    VVSub (dr, shift);
-                    if (VLenSq (dr) < rrNebr) {
-                      if (nebrTabLenP[ip] * nThread >= nebrTabMax)
-                         ErrExit (ERR_TOO_MANY_NEBRS);
-                      nebrTabP[ip][2 * nebrTabLenP[ip]] = j1;
-                      nebrTabP[ip][2 * nebrTabLenP[ip] + 1] = j2;
-                      ++ nebrTabLenP[ip];
-                    }
-                  }
-                }
-              }
-            }
-          }
+      n = 0;
+      THREAD_SPLIT_LOOP (c, nc) {
+        THREAD_LOOP {
+          n += cellCountP[iq][c];
+          cellCountP[iq][c] = n - cellCountP[iq][c];
         }
       }
+      cellSumP[ip] = n;
+      break;
+    case 3:
+      THREAD_SPLIT_LOOP (c, nc) {
+        THREAD_LOOP cellCountP[iq][c] += cellSumP[ip];
+        cellStart[c] = cellCountP[0][c];
+      }
+      break;
+    case 4:
+      THREAD_SPLIT_LOOP (n, nMol) cellList[cellCountP[ip][cellOf[n]] ++] = n;
+      break;
+    case 5:
+      while ((t = ThreadNextTask (ip)) >= 0) {
+        j1 = t * TASK_LEN;
+        nTab = BuildNebrRows (&mol[0].r, sizeof (Mol), j1,
+           Min (j1 + TASK_LEN, nMol), rCut + rNebrShell, nebrTabP[ip],
+           nebrTabPtr, nebrTabMax / nThread);
+        n = (nTab >= 0) ? __atomic_fetch_add (&nebrTabUsed, nTab,
+           __ATOMIC_RELAXED) : 0;
+        if (nTab < 0 || n + nTab > nebrTabMax) {
+          __atomic_store_n (&nebrTabOver, 1, __ATOMIC_RELAXED);
+          break;
+        }
+        memcpy (nebrTabS + n, nebrTabP[ip], nTab * sizeof (int));
+        nebrChunkPos[t] = n;
+        nebrChunkLen[t] = nTab;
+      }
+      break;
+    case 6:
+      while ((t = ThreadNextTask (ip)) >= 0) {
+        memcpy (nebrTab + nebrChunkOff[t], nebrTabS + nebrChunkPos[t],
+           nebrChunkLen[t] * sizeof (int));
+        for (j1 = t * TASK_LEN; j1 < Min ((t + 1) * TASK_LEN, nMol); j1 ++)
+           nebrTabPtr[j1] += nebrChunkOff[t];
+      }
       break;
   }
   return (NULL);
 }
 
+/* with the half list each thread accumulates forces in its own copy of
+   the acceleration array and these are summed; with the full list
+   (nebrFull) every pair is evaluated twice, but each thread writes only
+   the accelerations of the particles it owns */
+
 void ComputeForces ()
 {
   int iq;
-  long ip;
 
-  THREAD_PROC_LOOP (ComputeForcesT, 1);
-  THREAD_PROC_LOOP (ComputeForcesT, 2);
+  SetThreadTasks (nMol, TASK_LEN, nebrTabPtr, forceTaskTime);
+  if (nebrFull) THREAD_PROC_LOOP (ComputeForcesT, 3);
+  else {
+    THREAD_PROC_LOOP (ComputeForcesT, 1);
+    SetThreadTasks (nMol, TASK_LEN, NULL, NULL);
+    THREAD_PROC_LOOP (ComputeForcesT, 2);
+  }
   uSum = 0.;
   THREAD_LOOP uSum += uSumP[iq];
 }
 
 void *ComputeForcesT (void *tr)
 {
-  VecR dr;
-  real fcVal, rr, rrCut, rri, rri3, uVal;
-  int j1, j2, n;
+  VecR *ra, dr, fi, ri;
+  real fcVal, rr, rrCut, rri, rri3, u, uVal;
+  int j1, j2, n, t;
   int ip, iq;
 
   QUERY_THREAD ();
   switch (QUERY_STAGE) {
     case 1:
       rrCut = Sqr (rCut);
-      DO_MOL VZero (raP[ip][n]);
-      uSumP[ip] = 0.;
-      for (n = 0; n < nebrTabLenP[ip]; n ++) {
-        j1 = nebrTabP[ip][2 * n];
-        j2 = nebrTabP[ip][2 * n + 1];
-        VSub (dr, mol[j1].r, mol[j2].r);
-        VWrapAll (dr);
-        rr = VLenSq (dr);
-        if (rr < rrCut) {
-          rri = 1. / rr;
-          rri3 = Cube (rri);
-          fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
-          uVal = 4. * rri3 * (rri3 - 1.) + 1.;
-          VVSAdd (raP[ip][j1], fcVal, dr);
-          VVSAdd (raP[ip][j2], - fcVal, dr);
-          uSumP[ip] += uVal;
+      ra = raP[ip];
+      DO_MOL VZero (ra[n]);
+      u = 0.;
+      THREAD_TASK_LOOP (t, j1) {
+        ri = mol[j1].r;
+        VZero (fi);
+        for (n = nebrTabPtr[j1]; n < nebrTabPtr[j1 + 1]; n ++) {
+          j2 = nebrTab[n];
+          VSub (dr, ri, mol[j2].r);
+          VWrapAll (dr);
+          rr = VLenSq (dr);
+          if (rr < rrCut) {
+            rri = 1. / rr;
+            rri3 = Cube (rri);
+            fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
+            uVal = 4. * rri3 * (rri3 - 1.) + 1.;
+            VVSAdd (fi, fcVal, dr);
+            VVSAdd (ra[j2], - fcVal, dr);
+            u += uVal;
+          }
         }
+        VVAdd (ra[j1], fi);
       }
+      uSumP[ip] = u;
       break;
     case 2:
-      THREAD_SPLIT_LOOP (n, nMol) {
+      THREAD_TASK_LOOP (t, n) {
         VZero (mol[n].ra);
         THREAD_LOOP VVAdd (mol[n].ra, raP[iq][n]);
       }
       break;
+    case 3:
+      rrCut = Sqr (rCut);
+      u = 0.;
+      THREAD_TASK_LOOP (t, j1) {
+        ri = mol[j1].r;
+        VZero (fi);
+        for (n = nebrTabPtr[j1]; n < nebrTabPtr[j1 + 1]; n ++) {
+          VSub (dr, ri, mol[nebrTab[n]].r);
+          VWrapAll (dr);
+          rr = VLenSq (dr);
+          if (rr < rrCut) {
+            rri = 1. / rr;
+            rri3 = Cube (rri);
+            fcVal = 48. * rri3 * (rri3 - 0.5) * rri;
+            uVal = 4. * rri3 * (rri3 - 1.) + 1.;
+            VVSAdd (fi, fcVal, dr);
+            u += uVal;
+          }
+        }
+        mol[j1].ra = fi;
+      }
+      uSumP[ip] = 0.5 * u;
+      break;
   }
   return (NULL);
 }
 
+/* the two largest displacements seen by each thread are merged */
+
 void LeapfrogStep (int part)
 {
-  long ip;
+  int iq;
 
+  SetThreadTasks (nMol, TASK_LEN, NULL, NULL);
   THREAD_PROC_LOOP (LeapfrogStepT, part);
+  if (part == 1) {
+    NEBR_DISP_ZERO;
+    THREAD_LOOP {
+      NEBR_DISP_MERGE (dispSqP[2 * iq], nebrDispSq1, nebrDispSq2);
+      NEBR_DISP_MERGE (dispSqP[2 * iq + 1], nebrDispSq1, nebrDispSq2);
+    }
+    if (NEBR_DISP_OVER (rNebrShell)) nebrNow = 1;
+  }
 }
 
 void *LeapfrogStepT (void *tr)
 {
-  int ip, n;
+  VecR d;
+  real dd, dd1, dd2;
+  int ip, n, t;
 
   QUERY_THREAD ();
   switch (QUERY_STAGE) {
     case 1:
-      THREAD_SPLIT_LOOP (n, nMol) {
+      dd1 = dd2 = 0.;
+      THREAD_TASK_LOOP (t, n) {
         VVSAdd (mol[n].rv, 0.5 * deltaT, mol[n].ra);
         VVSAdd (mol[n].r, deltaT, mol[n].rv);
+        VSub (d, mol[n].r, nebrRefR[n]);
+        VWrapAll (d);
+        dd = VLenSq (d);
+        NEBR_DISP_MERGE (dd, dd1, dd2);
       }
+      dispSqP[2 * ip] = dd1;
+      dispSqP[2 * ip + 1] = dd2;
       break;
     case 2:
-      THREAD_SPLIT_LOOP (n, nMol)
-         VVSAdd (mol[n].rv, 0.5 * deltaT, mol[n].ra);
+      THREAD_TASK_LOOP (t, n) VVSAdd (mol[n].rv, 0.5 * deltaT, mol[n].ra);
       break;
   }
   return (NULL);
@@ -303,17 +436,16 @@ void *LeapfrogStepT (void *tr)
 
 void ApplyBoundaryCond ()
 {
-  long ip;
-
+  SetThreadTasks (nMol, TASK_LEN, NULL, NULL);
   THREAD_PROC_LOOP (ApplyBoundaryCondT, 0);
 }
 
 void *ApplyBoundaryCondT (void *tr)
 {
-  int ip, n;
+  int ip, n, t;
 
   QUERY_THREAD ();
-  THREAD_SPLIT_LOOP (n, nMol) VWrapAll (mol[n].r);
+  THREAD_TASK_LOOP (t, n) VWrapAll (mol[n].r);
   return (NULL);
 }
 
@@ -378,20 +510,16 @@ void InitAccels ()
 
 void EvalProps ()
 {
-  real vv, vvMax;
+  real vv;
   int n;
 
   VZero (vSum);
   vvSum = 0.;
-  vvMax = 0.;
   DO_MOL {
     VVAdd (vSum, mol[n].rv);
     vv = VLenSq (mol[n].rv);
     vvSum += vv;
-    vvMax = Max (vvMax, vv);
   }
-  dispHi += sqrt (vvMax) * deltaT;
-  if (dispHi > 0.5 * rNebrShell) nebrNow = 1;
   kinEnergy.val = 0.5 * vvSum / nMol;
   totEnergy.val = kinEnergy.val + uSum / nMol;
 }
@@ -425,4 +553,7 @@ void PrintSummary (FILE *fp)
 #include "in_rand.c"
 #include "in_errexit.c"
 #include "in_namelist.c"
+#include "in_cellbin.c"
+#include "in_nebrlist.c"
+#include "in_thread.c"
 
@@ -27,6 +27,7 @@
 
 
 #include "in_mddefs.h"
+#include "in_cellbin.h"
 
 typedef struct {
   VecR r;
@@ -42,7 +43,7 @@ VecR region;
 VecI cells;
 real rClust, timeNow;
 Prop cSize;
-int *cellList, bigSize, blockNum, blockSize, nMol, nCellEdge, nClust, nSingle,
+int bigSize, blockNum, blockSize, nMol, nCellEdge, nClust, nSingle,
    runId, stepCount;
 FILE *fp;
 
@@ -73,37 +74,29 @@ void AllocArrays ()
 {
   AllocMem (mol, nMol, Mol);
   AllocMem (clust, nMol, Clust);
-  AllocMem (cellList, Cube (nCellEdge) + nMol, int);
+  AllocCellBins (Cube (nCellEdge), nMol);
 }
 
 
 void BuildClusters ()
 {
-  VecR dr, invWid, rs, shift;
-  VecI cc, m1v, m2v, vOff[] = OFFSET_VALS;
+  VecR dr, shift;
+  VecI m1v, m2v, vOff[] = OFFSET_VALS;
   real rrClust;
-  int c, j1, j2, m1, m1x, m1y, m1z, m2, n, offset;
+  int j1, j2, m1, m1x, m1y, m1z, m2, offset;
 
   rrClust = Sqr (rClust);
-  VDiv (invWid, cells, region);
-  for (n = nMol; n < nMol + VProd (cells); n ++) cellList[n] = -1;
-  DO_MOL {
-    VSAdd (rs, mol[n].r, 0.5, region);
-    VMul (cc, rs, invWid);
-    c = VLinear (cc, cells) + nMol;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
-  }
+  BIN_CELLS (mol, nMol);
   for (m1z = 0; m1z < cells.z; m1z ++) {
     for (m1y = 0; m1y < cells.y; m1y ++) {
       for (m1x = 0; m1x < cells.x; m1x ++) {
         VSet (m1v, m1x, m1y, m1z);
-        m1 = VLinear (m1v, cells) + nMol;
+        m1 = VLinear (m1v, cells);
         for (offset = 0; offset < N_OFFSET; offset ++) {
           VAdd (m2v, m1v, vOff[offset]);
           VZero (shift);
           VCellWrapAll ();
-          m2 = VLinear (m2v, cells) + nMol;
+          m2 = VLinear (m2v, cells);
           DO_CELL (j1, m1) {
             DO_CELL (j2, m2) {
               if (m1 != m2 || j2 < j1) {
@@ -233,7 +226,7 @@ int GetConfig ()
       AllocArrays ();
       blockNum = 1;
     }
-    AllocMem (rI, NDIM * nMol, short);
+    AllocScratch (rI, 0, NDIM * nMol, short);
     ReadFN (rI, NDIM * nMol);
     DO_MOL {
       VFromLin (w, rI, NDIM * n);
@@ -241,7 +234,6 @@ int GetConfig ()
       VAddCon (w, w, -0.5);
       VMul (mol[n].r, w, region);
     }
-    free (rI);
     if (ferror (fp)) fOk = 0;
   }
   if (! fOk) ErrExit (ERR_SNAP_READ);
@@ -259,4 +251,5 @@ void SetupFiles ()
 
 
 #include "in_errexit.c"
+#include "in_cellbin.c"
 
@@ -166,13 +166,12 @@ int GetGridAverage ()
       if (plotMode == P_STREAM) AllocMem (streamFun, VProd (sizeHistGrid), real);
       blockNum = 1;
     }
-    AllocMem (hI, VProd (sizeHistGrid), short);
+    AllocScratch (hI, 0, VProd (sizeHistGrid), short);
     for (j = 0; j < NHIST; j ++) {
       ReadFN (hI, VProd (sizeHistGrid));
       for (n = 0; n < VProd (sizeHistGrid); n ++)
          histGrid[j][n] = hI[n] * histMax[j] / SCALE_FAC;
     }
-    free (hI);
     if (ferror (fp)) fOk = 0;
     fclose (fp);
   }
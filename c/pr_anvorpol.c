@@ -29,6 +29,7 @@
 #define READ_CONFIG  1
 
 #include "in_mddefs.h"
+#include "in_cellbin.h"
 
 #define MAX_EDGE   200
 #define MAX_FACE   50
@@ -66,7 +67,7 @@ VecI cells;
 real *distSq, cellRatio, eulerSum, fParamS, fracPolyVol, rangeLim,
    regionVol, timeNow, vDistSqMax;
 Prop polyGeom[4], polyArea, polyVol;
-int *cellList, *eCut, *eDel, *eNew, *fCut, *fDel, *siteSeq,
+int *eCut, *eDel, *eNew, *fCut, *fDel, *siteSeq,
    *testSites, *vDel, blockNum, blockSize, curSite, eLast, eLastP, fLast,
    fListLast, nCell, neCut, neDel, neNew, nfCut, nfDel, nMol, nTestSites,
    nvDel, runId, siteA, siteB, stepCount, vLast;
@@ -214,7 +215,7 @@ void AllocArrays ()
   AllocMem (testSites, nMol, int);
   AllocMem (distSq, nMol, real);
   AllocMem (siteSeq, nMol, int);
-  AllocMem (cellList, VProd (cells) + nMol, int);
+  AllocCellBins (VProd (cells), nMol);
   AllocMem (edge, MAX_EDGE, Edge);
   AllocMem (vert, MAX_VERT, Vert);
   AllocMem (face, MAX_FACE, Face);
@@ -265,20 +266,10 @@ void SetCellSize ()
 
 void SubdivCells ()
 {
-  VecR invWid, rs;
-  VecI cc;
-  int n, c;
+  int n;
 
-  VDiv (invWid, cells, region);
-  for (n = nMol; n < nMol + VProd (cells); n ++) cellList[n] = -1;
-  DO_MOL {
-    VSAdd (rs, mol[n].r, 0.5, region);
-    VMul (cc, rs, invWid);
-    c = VLinear (cc, cells) + nMol;
-    mol[n].inCell = c - nMol;
-    cellList[n] = cellList[c];
-    cellList[c] = n;
-  }
+  BIN_CELLS (mol, nMol);
+  DO_MOL mol[n].inCell = cellOf[n];
 }
 
 void FindTestSites (int na)
@@ -297,7 +288,7 @@ void FindTestSites (int na)
       cn.y = (cy + ofy + cells.y) % cells.y;
       for (ofx = -1; ofx <= 1; ofx ++) {
         cn.x = (cx + ofx + cells.x) % cells.x;
-        c = VLinear (cn, cells) + nMol;
+        c = VLinear (cn, cells);
         DO_CELL (i, c) {
           VSub (dr, mol[na].r, mol[i].r);
           VWrapAll (dr);
@@ -707,7 +698,7 @@ int GetConfig ()
       AllocArrays ();
       blockNum = 1;
     }
-    AllocMem (rI, NDIM * nMol, short);
+    AllocScratch (rI, 0, NDIM * nMol, short);
     ReadFN (rI, NDIM * nMol);
     DO_MOL {
       VFromLin (w, rI, NDIM * n);
@@ -715,7 +706,6 @@ int GetConfig ()
       VAddCon (w, w, -0.5);
       VMul (mol[n].r, w, region);
     }
-    free (rI);
     if (ferror (fp)) fOk = 0;
   }
   if (! fOk) ErrExit (ERR_SNAP_READ);
@@ -733,4 +723,5 @@ void SetupFiles ()
 
 
 #include "in_errexit.c"
+#include "in_cellbin.c"
 